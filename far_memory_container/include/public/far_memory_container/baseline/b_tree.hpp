@@ -198,6 +198,8 @@ private:
     template <class K>
     inline iterator find_impl(const K& x) const;
 
+    inline static void prefetch_next_subtree(const BTreeIterBase<Node>& it) noexcept;
+
     struct InsertStepResult {
         std::pair<iterator, bool> result;
         NodePtr new_child = nullptr;
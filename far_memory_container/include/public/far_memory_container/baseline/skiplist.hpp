@@ -426,6 +426,9 @@ constexpr auto SkiplistMap<Key, T, Compare, Allocator, URBG>::lower_bound_impl(c
                 break;
             }
 
+            if (level != 0) {
+                NodeAllocTraits::prefetch(lower_bound->links[level - 1].prev, sizeof(Node));
+            }
             if (comp(prev->value.get()->first, key)) {
                 prev_in_upper_level = std::move(prev);
                 break;
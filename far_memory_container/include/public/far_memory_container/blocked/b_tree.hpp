@@ -203,6 +203,8 @@ private:
     template <class K>
     inline iterator find_impl(const K& x) const;
 
+    inline static void prefetch_next_leaf(const BTreeIterBase<Node>& it) noexcept;
+
     struct InsertStepResult {
         std::pair<iterator, bool> result;
         NodePtr new_child = nullptr;
@@ -223,8 +225,11 @@ private:
 
     inline void relocate(NodePtr& node, Suballoc suballoc);
 
-    inline void batch_block_step(NodePtr node, Suballoc& swappable_block);
-    inline void batch_vEB_step(NodePtr& node, size_t height, Suballoc& swappable_block);
+    // both give far nodes an eviction priority of their height above the leaves, as upper nodes lie on more search paths
+    //! @return the height of `node` above the leaves
+    inline size_t batch_block_step(NodePtr node, Suballoc& swappable_block);
+    inline void batch_vEB_step(NodePtr& node, size_t height, size_t height_below, Suballoc& swappable_block);
+    inline void prioritize_by_height(NodePtr node, size_t height);
 
     template <size_t PageAlign>
     inline void analyze_edges_step(NodePtr node, std::array<size_t, 3>& acc);
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <bit>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <utility>
@@ -471,11 +472,12 @@ void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_block()
     batch_block_step(header->children[0], block);
 }
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
-void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_block_step(NodePtr node, Suballoc& block)
+size_t BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_block_step(NodePtr node, Suballoc& block)
 {
+    size_t height = 0;
     if (/* inner node */ node->children[0] != nullptr) {
         for (size_t i = 0; i <= node->n_elems; i++) {
-            batch_block_step(node->children[i], block);
+            height = batch_block_step(node->children[i], block) + 1;
         }
     }
 
@@ -485,7 +487,9 @@ void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_block_step(NodePtr n
             block = AllocTraits::get_suballocator(alloc, new_per_page);
         }
         relocate(node, block);
+        prioritize_by_height(node, height);
     }
+    return height;
 }
 
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
@@ -501,10 +505,10 @@ void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_vEB()
         height++;
     }
     auto block = AllocTraits::get_suballocator(alloc, new_per_page);
-    batch_vEB_step(root, height, block);
+    batch_vEB_step(root, height, 0, block);
 }
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
-void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_vEB_step(NodePtr& node, size_t height, Suballoc& block)
+void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_vEB_step(NodePtr& node, size_t height, size_t height_below, Suballoc& block)
 {
     switch (height) {
     case 0:
@@ -516,12 +520,13 @@ void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_vEB_step(NodePtr& no
                 block = AllocTraits::get_suballocator(alloc, new_per_page);
             }
             relocate(node, block);
+            prioritize_by_height(node, height_below);
         }
     } break;
 
     default: {
         const auto upper_height = (height + 1) / 2, lower_height = height - upper_height;
-        batch_vEB_step(node, upper_height, block);
+        batch_vEB_step(node, upper_height, height_below + lower_height, block);
 
         auto lower_first = node, lower_last = lower_first;
         for (auto down_cnt = upper_height; down_cnt != 0; down_cnt--) {
@@ -530,12 +535,20 @@ void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::batch_vEB_step(NodePtr& no
         }
 
         for (auto subtree = lower_first; subtree != lower_last; subtree = subtree->next) {
-            batch_vEB_step(subtree, lower_height, block);
+            batch_vEB_step(subtree, lower_height, height_below, block);
         }
-        batch_vEB_step(lower_last, lower_height, block);
+        batch_vEB_step(lower_last, lower_height, height_below, block);
     } break;
     }
 }
+template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
+void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::prioritize_by_height(NodePtr node, size_t height)
+{
+    // a leaf keeps its page's priority, as 0 would reset it; UINT8_MAX would pin the node
+    if (height != 0) {
+        AllocTraits::set_priority(node, sizeof(Node), static_cast<uint8_t>(std::min<size_t>(height, UINT8_MAX - 1)));
+    }
+}
 
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
 template <size_t PageAlign>
@@ -71,10 +71,20 @@ void BTreeIterBase<Node>::decrement()
 }
 
 
+template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
+void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::prefetch_next_leaf(const BTreeIterBase<Node>& it) noexcept
+{
+    // leaves share a depth, so on entering one the next node in the list is the leaf to be scanned after it
+    if (it.elem_idx == 0 && it.node->children[0] == nullptr && it.node->parent != nullptr) {
+        AllocTraits::prefetch(it.node->next, sizeof(Node));
+    }
+}
+
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
 auto BTreeMap<Key, T, MaxNElems, Compare, Allocator>::iterator::operator++() -> iterator&
 {
     Base::increment();
+    prefetch_next_leaf(*this);
     return *this;
 }
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
@@ -102,6 +112,7 @@ template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
 auto BTreeMap<Key, T, MaxNElems, Compare, Allocator>::const_iterator::operator++() -> const_iterator&
 {
     Base::increment();
+    prefetch_next_leaf(*this);
     return *this;
 }
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
@@ -432,6 +432,9 @@ constexpr auto SkiplistMap<Key, T, Compare, Allocator, URBG>::lower_bound_impl(c
                 break;
             }
 
+            if (level != 0) {
+                NodeAllocTraits::prefetch(lower_bound->links[level - 1].prev, sizeof(Node));
+            }
             if (comp(prev->value.get()->first, key)) {
                 prev_in_upper_level = std::move(prev);
                 break;
@@ -684,6 +687,11 @@ void SkiplistMap<Key, T, Compare, Allocator, URBG>::batch_block()
                 block = NodeAllocTraits::get_suballocator(node_alloc, new_per_page);
                 relocate(node, block);
             }
+            // a node of a higher level lies on more search paths
+            if (const auto priority = std::min<level_type>(node->level(), UINT8_MAX - 1); priority != 0) {
+                NodeAllocTraits::set_priority(node, sizeof(Node), priority);
+                LinkAllocTraits::set_priority(node->links, sizeof(Link) * (node->level() + 1u), priority);
+            }
         }
         node = node->links[0].prev;
     }
@@ -151,10 +151,21 @@ private:
     NodePtr begin_node = header;
 
 public:
+    //! the state of the map outside the arenas of its allocator (see FarMalloc::Checkpoint)
+    struct Anchor {
+        NodePtr header;
+        NodePtr begin_node;
+        size_type size_cnt;
+    };
+
     BTreeMap() {}
     BTreeMap(const Alloc& alloc) : alloc(alloc) {}
+    //! adopt the nodes of a map whose allocator has been restored from a checkpoint
+    BTreeMap(const Alloc& alloc, const Anchor& anchor) : size_cnt{anchor.size_cnt}, alloc(alloc), header{anchor.header}, begin_node{anchor.begin_node} {}
     inline ~BTreeMap() noexcept;
 
+    Anchor anchor() const noexcept { return {header, begin_node, size_cnt}; }
+
     iterator begin() noexcept { return iterator{{.node = begin_node, .elem_idx = 0}}; }
     const_iterator begin() const noexcept { return const_iterator{{.node = begin_node, .elem_idx = 0}}; }
     const_iterator cbegin() const noexcept { return begin(); }
@@ -199,6 +210,8 @@ private:
     template <class K>
     inline iterator find_impl(const K& x) const;
 
+    inline static void prefetch_next_subtree(const BTreeIterBase<Node>& it) noexcept;
+
     struct InsertStepResult {
         std::pair<iterator, bool> result;
         NodePtr new_child = nullptr;
@@ -58,6 +58,12 @@ template <class K>
 auto BTreeMap<Key, T, MaxNElems, Compare, Allocator>::find_impl(const K& x) const -> iterator
 {
     for (NodePtr node = header->children[0]; node != nullptr;) {
+        // the children mostly share pages, so requesting all of them overlaps the fetch with the search in this node
+        if (node->children[0] != nullptr) {
+            for (size_t i = 0; i <= node->n_elems; i++) {
+                AllocTraits::prefetch(node->children[i], sizeof(Node));
+            }
+        }
         const auto upper_bound = node->upper_bound(x, comp);
         if (upper_bound == 0 || comp(node->elems[upper_bound - 1].get()->first, x)) {
             node = node->children[upper_bound];
@@ -2,6 +2,7 @@
 
 #include <far_memory_container/page_aware/b_tree.hpp>
 
+#include <algorithm>
 #include <cstddef>
 #include <functional>
 #include <utility>
@@ -67,10 +68,24 @@ void BTreeIterBase<Node>::decrement()
 }
 
 
+template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
+void BTreeMap<Key, T, MaxNElems, Compare, Allocator>::prefetch_next_subtree(const BTreeIterBase<Node>& it) noexcept
+{
+    // on entering a leaf, the subtree right of the leaf's separator in its parent is visited right after the leaf
+    if (it.elem_idx == 0 && it.node->children[0] == nullptr && it.node->parent != nullptr) {
+        const auto& siblings = it.node->parent->children;
+        const auto idx = static_cast<size_t>(std::ranges::find(siblings, it.node) - siblings.begin());
+        if (idx < it.node->parent->n_elems) {
+            AllocTraits::prefetch(siblings[idx + 1], sizeof(Node));
+        }
+    }
+}
+
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
 auto BTreeMap<Key, T, MaxNElems, Compare, Allocator>::iterator::operator++() -> iterator&
 {
     Base::increment();
+    prefetch_next_subtree(*this);
     return *this;
 }
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
@@ -98,6 +113,7 @@ template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
 auto BTreeMap<Key, T, MaxNElems, Compare, Allocator>::const_iterator::operator++() -> const_iterator&
 {
     Base::increment();
+    prefetch_next_subtree(*this);
     return *this;
 }
 template <class Key, class T, size_t MaxNElems, class Compare, class Allocator>
@@ -2,6 +2,7 @@
 
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <tuple>
@@ -131,6 +132,50 @@ public:
         }
     }
 
+    // hint that [p, p + len) will be accessed soon, so that the allocator can start fetching it
+    // static, as iterators hold no allocator; a no-op unless Alloc::prefetch exists
+    static inline constexpr void prefetch(const_void_pointer p, size_type len) noexcept
+    {
+        if constexpr (requires { Alloc::prefetch(p, len); }) {
+            Alloc::prefetch(p, len);
+        }
+    }
+
+    // hint that [p, p + len) should outlive plain recency in local memory by `priority` steps;
+    // memory shared with other hinted objects keeps the highest priority, UINT8_MAX pins it and 0 resets it
+    // static like prefetch; a no-op unless Alloc::set_priority exists
+    // best effort, even for pins: the pager may not support it, a hint racing with a mode change is dropped,
+    // and the priority is forgotten when the memory goes local and far again, so re-apply it after mode changes
+    static inline constexpr void set_priority(const_void_pointer p, size_type len, std::uint8_t priority) noexcept
+    {
+        if constexpr (requires { Alloc::set_priority(p, len, priority); }) {
+            Alloc::set_priority(p, len, priority);
+        }
+    }
+
+    // hint that [p, p + len) will not be accessed for a while, so that the allocator can write it back and release its memory now
+    // static like prefetch; a no-op unless Alloc::mark_cold exists
+    static inline constexpr void mark_cold(const_void_pointer p, size_type len)
+    {
+        if constexpr (requires { Alloc::mark_cold(p, len); }) {
+            Alloc::mark_cold(p, len);
+        }
+    }
+
+    // set_priority and mark_cold for all the memory a suballocator carves from, when it owns such a block of its own
+    static inline constexpr void set_block_priority(Alloc& alloc, std::uint8_t priority) noexcept
+    {
+        if constexpr (requires { alloc.set_block_priority(priority); }) {
+            alloc.set_block_priority(priority);
+        }
+    }
+    static inline constexpr void mark_block_cold(Alloc& alloc)
+    {
+        if constexpr (requires { alloc.mark_block_cold(); }) {
+            alloc.mark_block_cold();
+        }
+    }
+
 private:
     template <size_t, class Ptrs>
     static inline constexpr void batch_allocate_helper(Alloc&, Ptrs&)
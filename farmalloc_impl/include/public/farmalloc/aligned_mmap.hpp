@@ -1,9 +1,10 @@
 #pragma once
 
+#include <farmalloc/huge_pages.hpp>
 #include <farmalloc/page_size.hpp>
 
 #include <errno.h>     // errno
-#include <sys/mman.h>  // mmap, munmap
+#include <sys/mman.h>  // madvise, mmap, munmap
 
 #include <bit>
 #include <cassert>
@@ -16,16 +17,31 @@ namespace FarMalloc
 {
 
 // given some natural number k, allocate size bytes starting from Alignment * k + Offset
+// (with huge pages, the mapping is HugePageExtent(size, huge) bytes and must be released by MUnmap with the same mode)
 template <size_t Alignment, size_t Offset>
-inline void* AlignedMMap(const size_t size)
+inline void* AlignedMMap(const size_t size, HugePageMode huge = HugePageMode::none)
 {
     assert(size > 0 && size % PageSize == 0);
     static_assert(Alignment > 0 && Alignment % PageSize == 0 && std::has_single_bit(Alignment));
     static_assert(Offset % PageSize == 0);
-    constexpr size_t MMapPadding = Alignment - PageSize;
-    const size_t mmap_size = size + MMapPadding;
+    assert(huge == HugePageMode::none || (Alignment % HugePageSize == 0 && Offset % HugePageSize == 0));
+    const size_t map_size = HugePageExtent(size, huge);
+    size_t mmap_size = map_size + Alignment - PageSize;
 
-    const auto mmap_result = mmap(NULL, mmap_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* mmap_result = MAP_FAILED;
+    if (huge == HugePageMode::hugetlb) {
+        // hugetlb mappings start on a huge page already
+        mmap_result = mmap(NULL, map_size + Alignment - HugePageSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (std::countr_zero(HugePageSize) << MAP_HUGE_SHIFT), -1, 0);
+        if (mmap_result != MAP_FAILED) {
+            mmap_size = map_size + Alignment - HugePageSize;
+        } else {
+            huge = HugePageMode::transparent;  // the pool is empty or not configured
+        }
+    }
+    if (mmap_result == MAP_FAILED) {
+        mmap_result = mmap(NULL, mmap_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
     if (mmap_result == MAP_FAILED) [[unlikely]] {
         if (errno == ENOMEM) [[likely]] {
             throw std::bad_alloc{};
@@ -43,7 +59,7 @@ inline void* AlignedMMap(const size_t size)
             throw std::system_error{errno, std::generic_category(), "munmap"};
         }
     }
-    if (const auto tail = aligned_addr + size, cut = mmap_head_addr + mmap_size - tail; cut != 0) {
+    if (const auto tail = aligned_addr + map_size, cut = mmap_head_addr + mmap_size - tail; cut != 0) {
         if (munmap(reinterpret_cast<void*>(tail), cut) == -1) [[unlikely]] {
             if (errno == ENOMEM) [[likely]] {
                 throw std::bad_alloc{};
@@ -52,12 +68,16 @@ inline void* AlignedMMap(const size_t size)
         }
     }
 
+    if (huge == HugePageMode::transparent) {
+        madvise(reinterpret_cast<void*>(aligned_addr), map_size, MADV_HUGEPAGE);  // a hint: THP may be disabled
+    }
+
     return reinterpret_cast<void*>(aligned_addr);
 }
 
-inline void MUnmap(void* const ptr, const size_t size)
+inline void MUnmap(void* const ptr, const size_t size, const HugePageMode huge = HugePageMode::none)
 {
-    if (munmap(ptr, size) == -1) [[unlikely]] {
+    if (munmap(ptr, HugePageExtent(size, huge)) == -1) [[unlikely]] {
         if (errno == ENOMEM) [[likely]] {
             throw std::bad_alloc{};
         }
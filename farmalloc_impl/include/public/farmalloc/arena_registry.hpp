@@ -0,0 +1,85 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/collective_allocator_params.hpp>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+
+namespace FarMalloc
+{
+
+struct FarMemoryGroup;
+
+struct RegionEntry {
+    void* ptr;
+    size_t size;
+    BackingStore* store;
+    FarMemoryGroup* group;
+    bool far;  // currently umapped
+};
+
+// Registry of the umapped regions: a three-level radix tree over the ArenaSize-granular slots of the address space.
+// No two regions start in the same slot, and a region is recorded in every slot it covers,
+// so the region containing any address is found with three dependent loads and no lock.
+// Slots are guarded by sequence locks; interior nodes are installed with CAS and never freed.
+struct ArenaRegistry {
+    inline static constexpr unsigned AddrBits = 48,
+                                     SlotShift = std::bit_width(ArenaSize) - 1,
+                                     LeafBits = 9, MidBits = 9,
+                                     RootBits = AddrBits - SlotShift - LeafBits - MidBits;
+
+    struct Slot {
+        std::atomic_uint32_t seq{0};
+        std::atomic<uintptr_t> ptr{0};
+        std::atomic_size_t size{0};
+        std::atomic<BackingStore*> store{nullptr};
+        std::atomic<FarMemoryGroup*> group{nullptr};
+        std::atomic_bool far{false};
+
+        inline void write(uintptr_t ptr, size_t size, BackingStore* store, FarMemoryGroup* group, bool far) noexcept;
+        inline std::optional<RegionEntry> read() const noexcept;
+    };
+    struct Leaf {
+        std::array<Slot, size_t{1} << LeafBits> slots;
+    };
+    struct Mid {
+        std::array<std::atomic<Leaf*>, size_t{1} << MidBits> leaves{};
+    };
+
+    std::array<std::atomic<Mid*>, size_t{1} << RootBits> root{};
+
+    inline constexpr ArenaRegistry() noexcept = default;
+    ArenaRegistry(const ArenaRegistry&) = delete;
+    inline ~ArenaRegistry();
+
+    inline void insert(void* ptr, size_t size, BackingStore* store, FarMemoryGroup* group, bool far);
+    inline void set_far(void* ptr, size_t size, bool far) noexcept;
+    inline void erase(void* ptr, size_t size) noexcept;
+
+    // the region containing `addr`, if any
+    inline std::optional<RegionEntry> find(const void* addr) const noexcept;
+    // the lowest region starting at or after `from`, if any
+    inline std::optional<RegionEntry> find_next(const void* from) const noexcept;
+
+    // visit every region once, in ascending order of address
+    template <class Func>
+    inline void for_each(Func&& func) const;
+
+private:
+    inline Slot& slot(uintptr_t key);
+    inline const Slot* find_slot(uintptr_t key) const noexcept;
+
+    // visit the regions starting in slot `first_key` or later while `func` returns true
+    template <class Func>
+    inline void walk(uintptr_t first_key, Func&& func) const;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/arena_registry.ipp>
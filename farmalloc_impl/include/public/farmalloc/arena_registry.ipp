@@ -0,0 +1,195 @@
+#pragma once
+
+#include <farmalloc/arena_registry.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+
+namespace FarMalloc
+{
+
+void ArenaRegistry::Slot::write(uintptr_t new_ptr, size_t new_size, BackingStore* new_store, FarMemoryGroup* new_group, bool new_far) noexcept
+{
+    seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ptr.store(new_ptr, std::memory_order_relaxed);
+    size.store(new_size, std::memory_order_relaxed);
+    store.store(new_store, std::memory_order_relaxed);
+    group.store(new_group, std::memory_order_relaxed);
+    far.store(new_far, std::memory_order_relaxed);
+    seq.fetch_add(1, std::memory_order_release);
+}
+std::optional<RegionEntry> ArenaRegistry::Slot::read() const noexcept
+{
+    while (true) {
+        const auto seq_before = seq.load(std::memory_order_acquire);
+        if (seq_before % 2 != 0) {
+            continue;
+        }
+        const auto res_ptr = ptr.load(std::memory_order_relaxed);
+        const auto res_size = size.load(std::memory_order_relaxed);
+        const auto res_store = store.load(std::memory_order_relaxed);
+        const auto res_group = group.load(std::memory_order_relaxed);
+        const auto res_far = far.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == seq_before) {
+            if (res_store == nullptr) {
+                return std::nullopt;
+            }
+            return RegionEntry{reinterpret_cast<void*>(res_ptr), res_size, res_store, res_group, res_far};
+        }
+    }
+}
+
+
+ArenaRegistry::~ArenaRegistry()
+{
+    for (auto& mid_ptr : root) {
+        if (auto* const mid = mid_ptr.load(std::memory_order_relaxed); mid != nullptr) {
+            for (auto& leaf : mid->leaves) {
+                delete leaf.load(std::memory_order_relaxed);
+            }
+            delete mid;
+        }
+    }
+}
+
+void ArenaRegistry::insert(void* ptr, size_t size, BackingStore* store, FarMemoryGroup* group, bool far)
+{
+    assert(size > 0);
+    const auto addr = reinterpret_cast<uintptr_t>(ptr);
+    const auto last_key = (addr + size - 1) >> SlotShift;
+    for (auto key = addr >> SlotShift; key <= last_key; key++) {
+        slot(key).write(addr, size, store, group, far);
+    }
+}
+void ArenaRegistry::set_far(void* ptr, size_t size, bool far) noexcept
+{
+    const auto addr = reinterpret_cast<uintptr_t>(ptr);
+    const auto last_key = (addr + size - 1) >> SlotShift;
+    for (auto key = addr >> SlotShift; key <= last_key; key++) {
+        // every slot of a registered region exists
+        auto* const s = const_cast<Slot*>(find_slot(key));
+        s->write(addr, size, s->store.load(std::memory_order_relaxed), s->group.load(std::memory_order_relaxed), far);
+    }
+}
+void ArenaRegistry::erase(void* ptr, size_t size) noexcept
+{
+    const auto addr = reinterpret_cast<uintptr_t>(ptr);
+    const auto last_key = (addr + size - 1) >> SlotShift;
+    for (auto key = addr >> SlotShift; key <= last_key; key++) {
+        const_cast<Slot*>(find_slot(key))->write(0, 0, nullptr, nullptr, false);
+    }
+}
+
+std::optional<RegionEntry> ArenaRegistry::find(const void* addr) const noexcept
+{
+    const auto key = reinterpret_cast<uintptr_t>(addr) >> SlotShift;
+    const auto* const s = find_slot(key);
+    if (s == nullptr) {
+        return std::nullopt;
+    }
+    const auto entry = s->read();
+    if (!entry || addr < entry->ptr || static_cast<const std::byte*>(addr) >= static_cast<const std::byte*>(entry->ptr) + entry->size) {
+        return std::nullopt;
+    }
+    return entry;
+}
+
+std::optional<RegionEntry> ArenaRegistry::find_next(const void* from) const noexcept
+{
+    std::optional<RegionEntry> res;
+    walk(reinterpret_cast<uintptr_t>(from) >> SlotShift, [&](const RegionEntry& entry) {
+        if (entry.ptr < from) {
+            return true;
+        }
+        res = entry;
+        return false;
+    });
+    return res;
+}
+
+template <class Func>
+void ArenaRegistry::for_each(Func&& func) const
+{
+    walk(0, [&](const RegionEntry& entry) {
+        func(entry);
+        return true;
+    });
+}
+
+template <class Func>
+void ArenaRegistry::walk(uintptr_t first_key, Func&& func) const
+{
+    constexpr size_t MidMask = (size_t{1} << MidBits) - 1, LeafMask = (size_t{1} << LeafBits) - 1;
+    for (size_t root_idx = first_key >> (MidBits + LeafBits); root_idx < root.size(); root_idx++) {
+        const auto* const mid = root[root_idx].load(std::memory_order_acquire);
+        if (mid == nullptr) {
+            continue;
+        }
+        const bool first_mid = root_idx == first_key >> (MidBits + LeafBits);
+        for (size_t mid_idx = first_mid ? (first_key >> LeafBits) & MidMask : 0; mid_idx < mid->leaves.size(); mid_idx++) {
+            const auto* const leaf = mid->leaves[mid_idx].load(std::memory_order_acquire);
+            if (leaf == nullptr) {
+                continue;
+            }
+            const bool first_leaf = first_mid && mid_idx == ((first_key >> LeafBits) & MidMask);
+            for (size_t leaf_idx = first_leaf ? first_key & LeafMask : 0; leaf_idx < leaf->slots.size(); leaf_idx++) {
+                const auto key = (root_idx << (MidBits + LeafBits)) | (mid_idx << LeafBits) | leaf_idx;
+                // slots covered by a region starting in an earlier slot are skipped
+                if (const auto entry = leaf->slots[leaf_idx].read(); entry && reinterpret_cast<uintptr_t>(entry->ptr) >> SlotShift == key) {
+                    if (!func(*entry)) {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+auto ArenaRegistry::slot(uintptr_t key) -> Slot&
+{
+    assert(key >> (RootBits + MidBits + LeafBits) == 0);
+    auto& mid_ptr = root[key >> (MidBits + LeafBits)];
+    auto* mid = mid_ptr.load(std::memory_order_acquire);
+    if (mid == nullptr) {
+        auto* const new_mid = new Mid;
+        if (mid_ptr.compare_exchange_strong(mid, new_mid, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            mid = new_mid;
+        } else {
+            delete new_mid;
+        }
+    }
+    auto& leaf_ptr = mid->leaves[(key >> LeafBits) & ((size_t{1} << MidBits) - 1)];
+    auto* leaf = leaf_ptr.load(std::memory_order_acquire);
+    if (leaf == nullptr) {
+        auto* const new_leaf = new Leaf;
+        if (leaf_ptr.compare_exchange_strong(leaf, new_leaf, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            leaf = new_leaf;
+        } else {
+            delete new_leaf;
+        }
+    }
+    return leaf->slots[key & ((size_t{1} << LeafBits) - 1)];
+}
+auto ArenaRegistry::find_slot(uintptr_t key) const noexcept -> const Slot*
+{
+    if (key >> (RootBits + MidBits + LeafBits) != 0) {
+        return nullptr;
+    }
+    const auto* const mid = root[key >> (MidBits + LeafBits)].load(std::memory_order_acquire);
+    if (mid == nullptr) {
+        return nullptr;
+    }
+    const auto* const leaf = mid->leaves[(key >> LeafBits) & ((size_t{1} << MidBits) - 1)].load(std::memory_order_acquire);
+    if (leaf == nullptr) {
+        return nullptr;
+    }
+    return &leaf->slots[key & ((size_t{1} << LeafBits) - 1)];
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <farmalloc/file_store.hpp>
+#include <farmalloc/io_uring.hpp>
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+// FileStore whose transfers go through one process-wide io_uring.
+// Writebacks are copied to staging buffers and queued; the queue is submitted with a single system call
+// when it reaches `batch_size` entries or when a read has to wait anyway, so bursts of evictions are batched.
+// Reads of pages whose writeback is still pending are served from the staging buffers, and other reads overlapping them
+// wait for them to land. A writeback that fails even when redone synchronously stays staged, counted in `failed_writes`,
+// serving reads until the page is written again.
+struct AsyncFileStore : FileStore {
+    struct Request {
+        char* buf;  // the caller's buffer for reads, the staging buffer for writes
+        size_t size;
+        off_t pos;  // absolute position in the file
+        bool is_write;
+        bool submitted = false;
+        bool done = false;
+        bool failed = false;  // a write that could not be redone either
+        ssize_t res = 0;
+    };
+
+    static IoUring ring;
+    static std::mutex ring_mtx;
+    static std::condition_variable ring_cv;
+    static bool reaping;
+    static size_t n_in_flight;  // queued or submitted, not reaped yet
+    static unsigned batch_size;
+    static std::deque<Request*> queued;
+    static std::map<off_t, Request*> pending_writes;  // by position; they never overlap one another
+    static std::atomic_uint64_t failed_writes;
+
+    using FileStore::FileStore;
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    // queued buffer by buffer, so that the pending writebacks keep serving reads and absorbing rewrites
+    inline ssize_t write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept override { return BackingStore::write_vectored(iov, iovcnt, off); }
+
+    // open the backing file like FileStore::open; if io_uring is unavailable,
+    // the file is still opened and swappable regions fall back to the synchronous FileStore
+    inline static void open(const char* path, bool direct = false, unsigned queue_depth = 256, unsigned batch = 32);
+    inline static void close();
+    inline static bool is_active() noexcept { return ring.is_active(); }
+    // wait until every queued transfer has completed; failed writebacks stay staged
+    inline static void drain() noexcept;
+
+private:
+    inline static void enqueue(Request& req, std::unique_lock<std::mutex>& lk) noexcept;
+    inline static void submit_queued() noexcept;
+    inline static void wait_completion(std::unique_lock<std::mutex>& lk) noexcept;
+    inline static void reap_completions() noexcept;
+    // the first pending write overlapping [pos, pos + size), or the end
+    inline static std::map<off_t, Request*>::iterator first_overlap(off_t pos, size_t size) noexcept;
+    inline static bool overlaps_in_flight(off_t pos, size_t size) noexcept;
+    // forget the failed writebacks starting in [begin, end), whose contents are no longer wanted
+    inline static void drop_failed(off_t begin, off_t end) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/async_file_store.ipp>
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <farmalloc/async_file_store.hpp>
+
+#include <farmalloc/file_store.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <errno.h>  // errno
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <new>
+#include <thread>
+
+
+namespace FarMalloc
+{
+
+void AsyncFileStore::destroy(size_t size)
+{
+    drain();  // the extent may be reused as soon as it is released
+    drop_failed(base, base + static_cast<off_t>(size));
+    FileStore::destroy(size);
+}
+void AsyncFileStore::populate(const std::byte* src, size_t size)
+{
+    drain();  // stale writebacks must not overtake the new contents
+    drop_failed(base, base + static_cast<off_t>(size));
+    FileStore::populate(src, size);
+}
+void AsyncFileStore::discard(off_t off, size_t size) noexcept
+{
+    drain();  // a pending writeback would refill the hole
+    drop_failed(base + off, base + off + static_cast<off_t>(size));
+    FileStore::discard(off, size);
+}
+
+ssize_t AsyncFileStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    LocalMemoryStore::read_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto pos = base + off;
+    Request req{.buf = buf, .size = size_in_bytes, .pos = pos, .is_write = false};
+    std::unique_lock lk{ring_mtx};
+    if (const auto it = pending_writes.find(pos); it != pending_writes.end() && it->second->size == size_in_bytes) {
+        std::memcpy(buf, it->second->buf, size_in_bytes);
+        return static_cast<ssize_t>(size_in_bytes);
+    }
+    while (overlaps_in_flight(pos, size_in_bytes)) {
+        wait_completion(lk);  // io_uring does not order the read after them
+    }
+    enqueue(req, lk);
+    submit_queued();  // one system call for this read and every writeback queued so far
+    while (!req.done) {
+        wait_completion(lk);
+    }
+    if (req.res != static_cast<ssize_t>(size_in_bytes)) [[unlikely]] {  // error or short read
+        lk.unlock();
+        if (pread_all(buf, size_in_bytes, pos) == -1) [[unlikely]] {
+            return -1;
+        }
+        lk.lock();
+    }
+
+    // failed writebacks are newer than the file
+    for (auto it = first_overlap(pos, size_in_bytes); it != pending_writes.end() && it->first < pos + static_cast<off_t>(size_in_bytes); ++it) {
+        if (it->second->failed) {
+            const auto begin = std::max(it->first, pos);
+            const auto end = std::min(it->first + static_cast<off_t>(it->second->size), pos + static_cast<off_t>(size_in_bytes));
+            std::memcpy(buf + (begin - pos), it->second->buf + (begin - it->first), static_cast<size_t>(end - begin));
+        }
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+ssize_t AsyncFileStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto pos = base + off;
+    std::unique_lock lk{ring_mtx};
+    for (auto it = first_overlap(pos, size_in_bytes); it != pending_writes.end(); it = first_overlap(pos, size_in_bytes)) {
+        auto* const req = it->second;
+        if (req->pos == pos && req->size == size_in_bytes && (!req->submitted || req->failed)) {  // overwrite the writeback in place
+            std::memcpy(req->buf, buf, size_in_bytes);
+            if (req->failed) {  // and try again
+                req->failed = false;
+                req->submitted = false;
+                enqueue(*req, lk);
+            }
+            return static_cast<ssize_t>(size_in_bytes);
+        }
+        if (req->failed) {  // a differently shaped page cannot be merged: it has to reach the file first
+            if (pwrite_all(req->buf, req->size, req->pos) == -1) [[unlikely]] {
+                return -1;
+            }
+            pending_writes.erase(it);
+            std::free(req->buf);
+            delete req;
+            continue;
+        }
+        wait_completion(lk);  // overlapping in-flight writes are not ordered
+    }
+
+    const auto staging_size = (size_in_bytes + PageSize - 1) / PageSize * PageSize;
+    auto* const staging = static_cast<char*>(std::aligned_alloc(PageSize, staging_size));
+    auto* const req = staging != nullptr ? new (std::nothrow) Request{.buf = staging, .size = size_in_bytes, .pos = pos, .is_write = true} : nullptr;
+    if (req == nullptr) [[unlikely]] {
+        std::free(staging);
+        lk.unlock();
+        return pwrite_all(buf, size_in_bytes, pos);
+    }
+    std::memcpy(staging, buf, size_in_bytes);
+    try {
+        pending_writes.emplace(pos, req);
+    } catch (...) {
+        std::free(staging);
+        delete req;
+        lk.unlock();
+        return pwrite_all(buf, size_in_bytes, pos);
+    }
+
+    enqueue(*req, lk);
+    if (ring.n_unsubmitted >= batch_size) {
+        submit_queued();
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+
+
+void AsyncFileStore::open(const char* path, bool direct, unsigned queue_depth, unsigned batch)
+{
+    FileStore::open(path, direct);
+    batch_size = batch;
+    ring.setup(queue_depth);
+}
+void AsyncFileStore::close()
+{
+    drain();
+    drop_failed(0, std::numeric_limits<off_t>::max());
+    ring.teardown();
+    FileStore::close();
+}
+void AsyncFileStore::drain() noexcept
+{
+    std::unique_lock lk{ring_mtx};
+    while (n_in_flight != 0) {
+        wait_completion(lk);
+    }
+}
+
+void AsyncFileStore::enqueue(Request& req, std::unique_lock<std::mutex>& lk) noexcept
+{
+    io_uring_sqe* sqe;
+    while (n_in_flight >= ring.cq_entries || (sqe = ring.get_sqe()) == nullptr) {
+        wait_completion(lk);
+    }
+    sqe->opcode = req.is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(req.buf);
+    sqe->len = static_cast<unsigned>(req.size);
+    sqe->off = static_cast<uint64_t>(req.pos);
+    sqe->user_data = reinterpret_cast<uintptr_t>(&req);
+    queued.push_back(&req);
+    n_in_flight++;
+}
+void AsyncFileStore::submit_queued() noexcept
+{
+    while (ring.n_unsubmitted != 0) {
+        const auto res = ring.submit();
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;  // EAGAIN/EBUSY: retried after the next completions are reaped
+        }
+        for (int i = 0; i < res; i++) {
+            queued.front()->submitted = true;
+            queued.pop_front();
+        }
+    }
+}
+// called with ring_mtx held; make progress by reaping at least one completion, or by waiting for the thread doing so
+void AsyncFileStore::wait_completion(std::unique_lock<std::mutex>& lk) noexcept
+{
+    if (reaping) {
+        ring_cv.wait(lk);
+        return;
+    }
+    submit_queued();
+    reaping = true;
+    if (ring.peek_cqe() == nullptr) {
+        const bool any_submitted = n_in_flight > queued.size();
+        lk.unlock();
+        if (any_submitted) {
+            ring.wait(1);  // sleeps in the kernel, even while the rest of the queue is refused
+        } else {  // the kernel refused the whole queue (EAGAIN): back off instead of spinning on the submission
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+        lk.lock();
+    }
+    reap_completions();
+    reaping = false;
+    ring_cv.notify_all();
+}
+void AsyncFileStore::reap_completions() noexcept
+{
+    for (io_uring_cqe* cqe; (cqe = ring.peek_cqe()) != nullptr; ring.cqe_seen()) {
+        auto* const req = reinterpret_cast<Request*>(static_cast<uintptr_t>(cqe->user_data));
+        req->res = cqe->res;
+        n_in_flight--;
+        if (req->is_write) {
+            if (req->res != static_cast<ssize_t>(req->size) && pwrite_all(req->buf, req->size, req->pos) == -1) [[unlikely]] {
+                // error or short write, and redoing it synchronously failed too: the staging buffer keeps the page
+                failed_writes.fetch_add(1, std::memory_order_relaxed);
+                req->failed = true;
+                continue;
+            }
+            if (const auto it = pending_writes.find(req->pos); it != pending_writes.end() && it->second == req) {
+                pending_writes.erase(it);
+            }
+            std::free(req->buf);
+            delete req;
+        } else {
+            req->done = true;
+        }
+    }
+}
+
+
+std::map<off_t, AsyncFileStore::Request*>::iterator AsyncFileStore::first_overlap(off_t pos, size_t size) noexcept
+{
+    auto it = pending_writes.lower_bound(pos);
+    if (it != pending_writes.begin()) {
+        if (const auto prev = std::prev(it); prev->first + static_cast<off_t>(prev->second->size) > pos) {
+            return prev;
+        }
+    }
+    return it != pending_writes.end() && it->first < pos + static_cast<off_t>(size) ? it : pending_writes.end();
+}
+bool AsyncFileStore::overlaps_in_flight(off_t pos, size_t size) noexcept
+{
+    for (auto it = first_overlap(pos, size); it != pending_writes.end() && it->first < pos + static_cast<off_t>(size); ++it) {
+        if (!it->second->failed) {
+            return true;
+        }
+    }
+    return false;
+}
+void AsyncFileStore::drop_failed(off_t begin, off_t end) noexcept
+{
+    std::lock_guard lk{ring_mtx};
+    for (auto it = pending_writes.lower_bound(begin); it != pending_writes.end() && it->first < end;) {
+        if (auto* const req = it->second; req->failed) {
+            it = pending_writes.erase(it);
+            std::free(req->buf);
+            delete req;
+        } else {
+            ++it;
+        }
+    }
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef FARMALLOC_UFFD_PAGER
+#include <umap/store/Store.hpp>
+#endif
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <cstddef>
+
+
+namespace FarMalloc
+{
+
+#ifdef FARMALLOC_UFFD_PAGER
+// what the pager calls to move pages; the same as Umap::Store, so that stores build against either pager
+struct PagerStore {
+    virtual ~PagerStore() = default;
+    virtual ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) = 0;
+    virtual ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) = 0;
+};
+#else
+using PagerStore = Umap::Store;
+#endif
+
+// common interface of the stores that hold the far copy of swappable regions
+struct BackingStore : PagerStore {
+    // release the resources for a region of `size` bytes (called instead of the destructor)
+    virtual void destroy(size_t size) = 0;
+    // copy the current local contents of a region into the store, just before the region gets umapped
+    virtual void populate(const std::byte* src, size_t size) = 0;
+    // write the buffers to consecutive offsets from `off`; stores that can gather them into one transfer override this
+    inline virtual ssize_t write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept;
+    // the allocator freed [off, off + size): the store may release its copy, which then reads back as zeros
+    inline virtual void discard(off_t, size_t) noexcept {}
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/backing_store.ipp>
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <cstddef>
+
+
+namespace FarMalloc
+{
+
+ssize_t BackingStore::write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept
+{
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (write_to_store(static_cast<char*>(iov[i].iov_base), iov[i].iov_len, off + total) != static_cast<ssize_t>(iov[i].iov_len)) [[unlikely]] {
+            return -1;
+        }
+        total += static_cast<ssize_t>(iov[i].iov_len);
+    }
+    return total;
+}
+
+}  // namespace FarMalloc
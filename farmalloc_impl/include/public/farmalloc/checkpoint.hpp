@@ -0,0 +1,69 @@
+#pragma once
+
+#include <farmalloc/collective_allocator.hpp>
+#include <farmalloc/per-page_suballocator.hpp>
+#include <farmalloc/swappable_plain_suballocator.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+// Saves the swappable arenas of a CollectiveAllocatorImpl, metadata pages and contents, to a file,
+// and maps them back at the same addresses in a later process, so that the containers built on them need no rebuilding.
+// Restored arenas are mapped privately from the file and their pages are read in on first touch;
+// in far-memory mode, they fault in through a CheckpointStore, which reads each page from the file until it is written back.
+// The allocator must be the only one in its FarMemoryGroup and must not hold large allocations (which have no arena
+// to record their store in); its purely-local arenas are not saved. The state of the containers that lives outside
+// the arenas travels as opaque `user_data`. Nothing may use the allocator while it is saved or restored.
+struct Checkpoint {
+    inline static constexpr uint64_t Magic = 0x3130'5450'4b43'4d46;  // "FMCKPT01"
+
+    struct Header {
+        uint64_t magic;
+        uint64_t page_size;
+        uint64_t arena_size;
+        uint64_t block_size;
+        uint64_t layout;  // mixes the sizes of the saved structures, to refuse files of another build
+        uint64_t n_arenas;
+        uint64_t user_data_size;
+    };
+
+    // the part of the allocator object that points into the arenas, with where its list heads used to be
+    template <size_t BlockSize>
+    struct AllocatorState {
+        decltype(SwappablePlainSuballocatorImpl::current_slabs) current_slabs;
+        decltype(SwappablePlainSuballocatorImpl::non_full_slabs) non_full_slabs;
+        decltype(SwappablePlainSuballocatorImpl::free_pages) free_pages;
+        const SlabLink* old_non_full_slabs;
+        const FreePageLink* old_free_pages;
+        PerPageSuballocatorArena<BlockSize>* current_arena;
+        PerPageArenaLink<BlockSize> non_full_arenas;
+        const PerPageArenaLink<BlockSize>* old_non_full_arenas;
+    };
+
+    template <size_t BlockSize>
+    inline static void save(const char* path, CollectiveAllocatorImpl<BlockSize>& impl, std::span<const std::byte> user_data = {});
+    // `impl` must be freshly constructed; returns the `user_data` given to save.
+    // Call it early, before other mappings (e.g. thread stacks) can take the saved addresses.
+    template <size_t BlockSize>
+    inline static std::vector<std::byte> restore(const char* path, CollectiveAllocatorImpl<BlockSize>& impl);
+
+private:
+    template <size_t BlockSize>
+    inline static constexpr uint64_t layout() noexcept;
+    // make the lists whose head was at `old_head` before the copy end at `head` again
+    template <class Link>
+    inline static void relink(Link& head, const Link* old_head) noexcept;
+
+    inline static void write_all(int fd, const void* buf, size_t size, off_t pos);
+    inline static void read_all(int fd, void* buf, size_t size, off_t pos);
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/checkpoint.ipp>
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <farmalloc/checkpoint.hpp>
+
+#include <farmalloc/checkpoint_store.hpp>
+#include <farmalloc/collective_allocator.hpp>
+#include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+#include <farmalloc/per-page_suballocator.hpp>
+#include <farmalloc/store_stats.hpp>
+#include <farmalloc/swappable_plain_suballocator.hpp>
+
+#include <errno.h>     // errno, EEXIST, EINVAL
+#include <fcntl.h>     // open, O_*
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // S_IRUSR, S_IWUSR
+#include <unistd.h>    // close, fsync, pread, pwrite
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+template <size_t BlockSize>
+void Checkpoint::save(const char* path, CollectiveAllocatorImpl<BlockSize>& impl, std::span<const std::byte> user_data)
+{
+    using PerPageArena = PerPageSuballocatorArena<BlockSize>;
+    auto& group = impl.far_memory_group();
+    std::shared_lock lock{group.mode_mtx};  // the arenas stay in one mode while they are read
+    impl.swappable_plain.flush_thread_cache();  // slots cached by other threads are saved as allocated
+
+    std::vector<uint64_t> arenas;
+    LocalMemoryStore::mapping.for_each([&](const RegionEntry& entry) {
+        if (entry.group == &group) {
+            arenas.push_back(reinterpret_cast<uintptr_t>(entry.ptr));
+        }
+    });
+    for (auto& addr : arenas) {
+        // the data of an arena follows its metadata pages, while a large allocation starts at its mapping
+        const auto base = addr / ArenaSize * ArenaSize;
+        if (base == addr) [[unlikely]] {
+            throw std::logic_error{"Checkpoint: large allocations cannot be saved"};
+        }
+        if ((base & CollectiveAllocatorImpl<BlockSize>::AddrMaskArenaKind) == PerPageOffset
+            && reinterpret_cast<PerPageArena*>(base)->block_alloc != &impl.block_allocator) [[unlikely]] {
+            throw std::logic_error{"Checkpoint: the FarMemoryGroup is shared with another allocator"};
+        }
+        addr = base;
+    }
+
+    const Header header{
+        .magic = Magic,
+        .page_size = PageSize,
+        .arena_size = ArenaSize,
+        .block_size = BlockSize,
+        .layout = layout<BlockSize>(),
+        .n_arenas = arenas.size(),
+        .user_data_size = user_data.size(),
+    };
+    const AllocatorState<BlockSize> state{
+        .current_slabs = impl.swappable_plain.current_slabs,
+        .non_full_slabs = impl.swappable_plain.non_full_slabs,
+        .free_pages = impl.swappable_plain.free_pages,
+        .old_non_full_slabs = impl.swappable_plain.non_full_slabs.data(),
+        .old_free_pages = impl.swappable_plain.free_pages.data(),
+        .current_arena = impl.block_allocator.current_arena,
+        .non_full_arenas = impl.block_allocator.non_full_arenas,
+        .old_non_full_arenas = &impl.block_allocator.non_full_arenas,
+    };
+
+    const int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "open"};
+    }
+    try {
+        off_t pos = 0;
+        write_all(fd, &header, sizeof(header), pos);
+        write_all(fd, &state, sizeof(state), pos += sizeof(header));
+        write_all(fd, user_data.data(), user_data.size(), pos += sizeof(state));
+        write_all(fd, arenas.data(), arenas.size() * sizeof(uint64_t), pos += static_cast<off_t>(user_data.size()));
+        pos = (pos + static_cast<off_t>(arenas.size() * sizeof(uint64_t) + PageSize - 1)) / static_cast<off_t>(PageSize) * static_cast<off_t>(PageSize);
+        for (const auto addr : arenas) {
+            // through the mapping, so that pages still in the pager's buffer are saved as they are
+            write_all(fd, reinterpret_cast<const void*>(addr), ArenaSize, pos);
+            pos += static_cast<off_t>(ArenaSize);
+        }
+        if (fsync(fd) == -1) [[unlikely]] {
+            throw std::system_error{errno, std::generic_category(), "fsync"};
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    if (::close(fd) == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "close"};
+    }
+}
+
+template <size_t BlockSize>
+std::vector<std::byte> Checkpoint::restore(const char* path, CollectiveAllocatorImpl<BlockSize>& impl)
+{
+    using PerPageArena = PerPageSuballocatorArena<BlockSize>;
+    if (impl.block_allocator.current_arena != nullptr || impl.block_allocator.non_full_arenas.next != &impl.block_allocator.non_full_arenas
+        || std::ranges::any_of(impl.swappable_plain.current_slabs, [](auto* slab) { return slab != nullptr; })
+        || std::ranges::any_of(impl.swappable_plain.free_pages, [](auto& head) { return head.next != &head; })) [[unlikely]] {
+        throw std::logic_error{"Checkpoint: restoring into an allocator in use"};
+    }
+
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "open"};
+    }
+    Header header;
+    AllocatorState<BlockSize> state;
+    std::vector<std::byte> user_data;
+    std::vector<uint64_t> arenas;
+    off_t arenas_pos;
+    size_t n_mapped = 0;
+    try {
+        off_t pos = 0;
+        read_all(fd, &header, sizeof(header), pos);
+        if (header.magic != Magic || header.page_size != PageSize || header.arena_size != ArenaSize || header.block_size != BlockSize
+            || header.layout != layout<BlockSize>()) [[unlikely]] {
+            throw std::system_error{EINVAL, std::generic_category(), "Checkpoint: not a checkpoint of this build"};
+        }
+        read_all(fd, &state, sizeof(state), pos += sizeof(header));
+        user_data.resize(header.user_data_size);
+        read_all(fd, user_data.data(), user_data.size(), pos += sizeof(state));
+        arenas.resize(header.n_arenas);
+        read_all(fd, arenas.data(), arenas.size() * sizeof(uint64_t), pos += static_cast<off_t>(user_data.size()));
+        pos = (pos + static_cast<off_t>(arenas.size() * sizeof(uint64_t) + PageSize - 1)) / static_cast<off_t>(PageSize) * static_cast<off_t>(PageSize);
+        arenas_pos = pos;
+
+        // map every arena at its old address, to be read in lazily from the file
+        for (; n_mapped < arenas.size(); n_mapped++, pos += static_cast<off_t>(ArenaSize)) {
+            auto* const addr = reinterpret_cast<void*>(arenas[n_mapped]);
+            const auto mapped = mmap(addr, ArenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, pos);
+            if (mapped == MAP_FAILED) [[unlikely]] {
+                throw std::system_error{errno, std::generic_category(), "mmap"};
+            } else if (mapped != addr) [[unlikely]] {  // kernels before 4.17 take the address as a hint only
+                munmap(mapped, ArenaSize);
+                throw std::system_error{EEXIST, std::generic_category(), "mmap"};
+            }
+        }
+    } catch (...) {
+        for (size_t i = 0; i < n_mapped; i++) {
+            munmap(reinterpret_cast<void*>(arenas[i]), ArenaSize);
+        }
+        ::close(fd);
+        throw;
+    }
+    // the stores read the pages not yet written back from the file
+    const std::shared_ptr<const CheckpointStore::File> file{new CheckpointStore::File{fd}};
+
+    impl.swappable_plain.current_slabs = state.current_slabs;
+    impl.swappable_plain.non_full_slabs = state.non_full_slabs;
+    impl.swappable_plain.free_pages = state.free_pages;
+    for (size_t i = 0; i < state.non_full_slabs.size(); i++) {
+        relink(impl.swappable_plain.non_full_slabs[i], state.old_non_full_slabs + i);
+    }
+    for (size_t i = 0; i < state.free_pages.size(); i++) {
+        relink(impl.swappable_plain.free_pages[i], state.old_free_pages + i);
+    }
+    impl.block_allocator.current_arena = state.current_arena;
+    impl.block_allocator.non_full_arenas = state.non_full_arenas;
+    relink(impl.block_allocator.non_full_arenas, state.old_non_full_arenas);
+
+    // the stores are built anew; the saved StoreBuffers only hold pointers into the old process
+    auto& group = impl.far_memory_group();
+    for (size_t i = 0; i < arenas.size(); i++) {
+        const auto addr = arenas[i];
+        const auto region_pos = [&](void* region) { return arenas_pos + static_cast<off_t>(i * ArenaSize + (reinterpret_cast<uintptr_t>(region) - addr)); };
+        if ((addr & CollectiveAllocatorImpl<BlockSize>::AddrMaskArenaKind) == PerPageOffset) {
+            auto& arena = *reinterpret_cast<PerPageArena*>(addr);
+            arena.block_alloc = &impl.block_allocator;
+            auto* const region = reinterpret_cast<void*>(arena.block_idx2head_ptr(0));
+            auto* const store = arena.store_buf.construct(region, PerPageArena::DataNPages * PageSize, ArenaKind::per_page, impl.block_allocator.factory, BlockSize, file, region_pos(region));
+            LocalMemoryStore::umap(region, PerPageArena::DataNPages * PageSize, store, group);
+        } else {
+            auto& arena = SwappablePlainArena::from_inside_ptr(reinterpret_cast<void*>(addr));
+            auto* const region = reinterpret_cast<void*>(arena.page_idx2head_ptr(0));
+            auto* const store = arena.store_buf().construct(region, SwappablePlainArena::DataNPages * PageSize, ArenaKind::swappable_plain, impl.swappable_plain.custom.factory, PageSize, file, region_pos(region));
+            LocalMemoryStore::umap(region, SwappablePlainArena::DataNPages * PageSize, store, group);
+        }
+    }
+    return user_data;
+}
+
+
+template <size_t BlockSize>
+constexpr uint64_t Checkpoint::layout() noexcept
+{
+    uint64_t res = 0;
+    for (const uint64_t size : {sizeof(SwappablePlainArena), sizeof(PerPageSuballocatorArena<BlockSize>), sizeof(StoreBuffer), sizeof(AllocatorState<BlockSize>)}) {
+        res = res * 0x100000001b3u + size;
+    }
+    return res;
+}
+template <class Link>
+void Checkpoint::relink(Link& head, const Link* old_head) noexcept
+{
+    if (head.next == old_head) {
+        head.next = head.prev = &head;
+        return;
+    }
+    head.next->prev = &head;
+    head.prev->next = &head;
+}
+
+void Checkpoint::write_all(int fd, const void* buf, size_t size, off_t pos)
+{
+    for (size_t done = 0; done < size;) {
+        const auto res = pwrite(fd, static_cast<const char*>(buf) + done, size - done, pos + static_cast<off_t>(done));
+        if (res == -1) [[unlikely]] {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error{errno, std::generic_category(), "pwrite"};
+        }
+        done += static_cast<size_t>(res);
+    }
+}
+void Checkpoint::read_all(int fd, void* buf, size_t size, off_t pos)
+{
+    for (size_t done = 0; done < size;) {
+        const auto res = pread(fd, static_cast<char*>(buf) + done, size - done, pos + static_cast<off_t>(done));
+        if (res == -1) [[unlikely]] {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error{errno, std::generic_category(), "pread"};
+        } else if (res == 0) [[unlikely]] {
+            throw std::system_error{EINVAL, std::generic_category(), "Checkpoint: truncated file"};
+        }
+        done += static_cast<size_t>(res);
+    }
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/page_bitmap.hpp>
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <cstddef>
+#include <memory>
+
+
+namespace FarMalloc
+{
+
+// Decorator under the other decorators of a region restored from a checkpoint: until a page is first written back,
+// its faults read it from the checkpoint file, so that restoring in far-memory mode copies nothing up front.
+struct CheckpointStore : BackingStore {
+    // the checkpoint file, closed with the last store reading from it
+    struct File {
+        int fd;
+
+        inline ~File();
+    };
+
+    BackingStore* inner;
+    std::shared_ptr<const File> file;
+    off_t base;  // where the region starts in the file
+    size_t n_pages;
+    PageBitmap in_file;  // the pages still only in the file
+
+    inline CheckpointStore(BackingStore* inner, std::shared_ptr<const File> file, off_t base, size_t size);
+    inline void destroy(size_t size) override { inner->destroy(size); }
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept override;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/checkpoint_store.ipp>
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <farmalloc/checkpoint_store.hpp>
+
+#include <farmalloc/page_size.hpp>
+
+#include <errno.h>      // EINTR, EIO
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+#include <unistd.h>     // close, pread
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+
+namespace FarMalloc
+{
+
+CheckpointStore::File::~File()
+{
+    ::close(fd);
+}
+
+CheckpointStore::CheckpointStore(BackingStore* inner, std::shared_ptr<const File> file, off_t base, size_t size)
+    : inner{inner}, file{std::move(file)}, base{base}, n_pages{size / PageSize}, in_file{n_pages, true} {}
+void CheckpointStore::populate(const std::byte* src, size_t size)
+{
+    in_file.assign(0, n_pages, false);  // everything is rewritten
+    inner->populate(src, size);
+}
+void CheckpointStore::discard(off_t off, size_t size) noexcept
+{
+    const auto first_page = static_cast<size_t>(off) / PageSize;
+    in_file.assign(first_page, first_page + size / PageSize, false);
+    inner->discard(off, size);
+}
+
+ssize_t CheckpointStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    // runs of pages are read from wherever they are
+    const auto first_page = static_cast<size_t>(off) / PageSize, last_page = (static_cast<size_t>(off) + size_in_bytes + PageSize - 1) / PageSize;
+    for (auto page = first_page; page < last_page;) {
+        const bool from_file = in_file.test(page);
+        auto end = page + 1;
+        while (end < last_page && in_file.test(end) == from_file) {
+            end++;
+        }
+        const auto begin_off = std::max(static_cast<size_t>(off), page * PageSize), end_off = std::min(static_cast<size_t>(off) + size_in_bytes, end * PageSize);
+        char* const dst = buf + (begin_off - static_cast<size_t>(off));
+        if (from_file) {
+            for (size_t done = 0; done < end_off - begin_off;) {
+                const auto res = pread(file->fd, dst + done, end_off - begin_off - done, base + static_cast<off_t>(begin_off + done));
+                if (res == -1 && errno == EINTR) {
+                    continue;
+                } else if (res <= 0) [[unlikely]] {
+                    if (res == 0) {
+                        errno = EIO;  // the file was truncated
+                    }
+                    return -1;
+                }
+                done += static_cast<size_t>(res);
+            }
+        } else if (inner->read_from_store(dst, end_off - begin_off, static_cast<off_t>(begin_off)) == -1) [[unlikely]] {
+            return -1;
+        }
+        page = end;
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+ssize_t CheckpointStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    const auto res = inner->write_to_store(buf, size_in_bytes, off);
+    if (res != -1) {
+        in_file.assign(static_cast<size_t>(off) / PageSize, (static_cast<size_t>(off) + size_in_bytes + PageSize - 1) / PageSize, false);
+    }
+    return res;
+}
+ssize_t CheckpointStore::write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept
+{
+    const auto res = inner->write_vectored(iov, iovcnt, off);
+    if (res != -1) {
+        in_file.assign(static_cast<size_t>(off) / PageSize, (static_cast<size_t>(off) + static_cast<size_t>(res) + PageSize - 1) / PageSize, false);
+    }
+    return res;
+}
+
+
+}  // namespace FarMalloc
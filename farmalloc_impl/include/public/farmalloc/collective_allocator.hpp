@@ -2,13 +2,20 @@
 
 #include <farmalloc/collective_allocator_traits.hpp>
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/far_memory_group.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/numa.hpp>
 #include <farmalloc/per-page_suballocator.hpp>
 #include <farmalloc/purely-local_suballocator.hpp>
+#include <farmalloc/store_factory.hpp>
 #include <farmalloc/swappable_plain_suballocator.hpp>
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <type_traits>
 #include <utility>
 #include <variant>
@@ -25,9 +32,14 @@ struct CollectiveAllocatorImpl {
     SwappablePlainSuballocatorImpl swappable_plain;
     PerPageBlockAllocator block_allocator;
 
-    size_t ref_count{0};
+    std::atomic_size_t ref_count{0};  // copies of the allocator may live in several threads
 
-    inline CollectiveAllocatorImpl(size_t purely_local_capacity) : purely_local{purely_local_capacity} {}
+    inline CollectiveAllocatorImpl(size_t purely_local_capacity, FarMemoryGroup& group = FarMemoryGroup::default_group,
+                                   StoreFactory factory = StoreFactory::automatic(), HugePageMode purely_local_huge_pages = HugePageMode::none,
+                                   NumaPolicy numa = {})
+        : purely_local{purely_local_capacity, purely_local_huge_pages, numa.purely_local},
+          swappable_plain{group, factory, numa.swappable_plain},
+          block_allocator{group, factory, numa.per_page} {}
     inline ~CollectiveAllocatorImpl() = default;
     CollectiveAllocatorImpl(const CollectiveAllocatorImpl&) = delete;
     CollectiveAllocatorImpl& operator=(const CollectiveAllocatorImpl&) = delete;
@@ -58,6 +70,9 @@ struct CollectiveAllocatorImpl {
         inline void deallocate(void* const ptr, const size_t n_elems);
 
         inline constexpr bool is_occupancy_under(double threshold) noexcept;
+
+        // the per-page block this suballocator carves, or nothing for a plain one
+        inline std::span<std::byte> block() noexcept;
     };
 
     inline static constexpr size_t AddrMaskArenaKind = (SubspaceInterval - 1u) & ~(ArenaSize - 1u);
@@ -69,6 +84,8 @@ struct CollectiveAllocatorImpl {
 
     inline SuballocatorImpl get_suballocator(FarMalloc::suballocator_kind kind);
     inline constexpr SuballocatorImpl get_suballocator(const void* const ptr) noexcept;
+
+    inline constexpr FarMemoryGroup& far_memory_group() noexcept { return *block_allocator.group; }
 };
 
 template <class T, size_t BlockSize>
@@ -99,16 +116,29 @@ struct Suballocator {
 
     inline constexpr bool contains(const void* ptr) noexcept;
     inline constexpr bool is_occupancy_under(double threshold) noexcept;
+
+    inline static void prefetch(const void* ptr, size_t len) noexcept { LocalMemoryStore::prefetch(ptr, len); }
+    inline static void set_priority(const void* ptr, size_t len, uint8_t priority) noexcept { LocalMemoryStore::set_priority(ptr, len, priority); }
+    inline static void mark_cold(const void* ptr, size_t len) { LocalMemoryStore::mark_cold(ptr, len); }
+
+    // the same for the whole per-page block; no-ops for a plain suballocator
+    inline void set_block_priority(uint8_t priority) noexcept;
+    inline void mark_block_cold();
 };
 
+// Copies may be used from several threads at once: plain allocations and deallocations are thread-safe,
+// and so is taking a new per-page suballocator, but each per-page block, with what is allocated in it,
+// must be used by one thread at a time.
 template <class T, size_t BlockSize>
 struct CollectiveAllocator {
     using Impl = CollectiveAllocatorImpl<BlockSize>;
 
     std::invoke_result_t<decltype(&Impl::shallow_copy), Impl*> pimpl;
 
-    inline constexpr CollectiveAllocator(size_t purely_local_capacity)
-        : pimpl{(new Impl{purely_local_capacity})->shallow_copy()} {}
+    inline constexpr CollectiveAllocator(size_t purely_local_capacity, FarMemoryGroup& group = FarMemoryGroup::default_group,
+                                         StoreFactory factory = StoreFactory::automatic(), HugePageMode purely_local_huge_pages = HugePageMode::none,
+                                         NumaPolicy numa = {})
+        : pimpl{(new Impl{purely_local_capacity, group, factory, purely_local_huge_pages, numa})->shallow_copy()} {}
     inline constexpr CollectiveAllocator(const CollectiveAllocator& other) noexcept : pimpl{other.pimpl->shallow_copy()} {}
     inline constexpr CollectiveAllocator& operator=(const CollectiveAllocator& other) noexcept { pimpl = other.pimpl->shallow_copy(); }
     inline constexpr CollectiveAllocator(CollectiveAllocator&&) noexcept = default;
@@ -136,6 +166,12 @@ struct CollectiveAllocator {
 
     inline suballocator get_suballocator(FarMalloc::suballocator_kind kind) { return suballocator{pimpl->get_suballocator(kind)}; }
     inline suballocator get_suballocator(const void* ptr) const noexcept { return suballocator{pimpl->get_suballocator(ptr)}; }
+
+    inline FarMemoryGroup& far_memory_group() const noexcept { return pimpl->far_memory_group(); }
+
+    inline static void prefetch(const void* ptr, size_t len) noexcept { LocalMemoryStore::prefetch(ptr, len); }
+    inline static void set_priority(const void* ptr, size_t len, uint8_t priority) noexcept { LocalMemoryStore::set_priority(ptr, len, priority); }
+    inline static void mark_cold(const void* ptr, size_t len) { LocalMemoryStore::mark_cold(ptr, len); }
 };
 
 }  // namespace FarMalloc
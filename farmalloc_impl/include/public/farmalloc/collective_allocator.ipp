@@ -4,13 +4,16 @@
 
 #include <farmalloc/collective_allocator_traits.hpp>
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/local_memory_store.hpp>
 #include <farmalloc/per-page_suballocator.hpp>
 
+#include <atomic>
 #include <bit>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <new>
+#include <span>
 #include <utility>
 #include <variant>
 
@@ -21,8 +24,7 @@ namespace FarMalloc
 template <size_t BlockSize>
 void CollectiveAllocatorImpl<BlockSize>::dec_ref(CollectiveAllocatorImpl* ptr) noexcept
 {
-    ptr->ref_count--;
-    if (ptr->ref_count == 0) {
+    if (ptr->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
         try {
             delete ptr;
         } catch (...) {  // deleter should not throw exception
@@ -32,7 +34,7 @@ void CollectiveAllocatorImpl<BlockSize>::dec_ref(CollectiveAllocatorImpl* ptr) n
 template <size_t BlockSize>
 auto CollectiveAllocatorImpl<BlockSize>::shallow_copy() noexcept -> std::unique_ptr<CollectiveAllocatorImpl, void (*)(CollectiveAllocatorImpl*)>
 {
-    ref_count++;
+    ref_count.fetch_add(1, std::memory_order_relaxed);
     return {this, dec_ref};
 }
 
@@ -61,6 +63,15 @@ constexpr bool CollectiveAllocatorImpl<BlockSize>::SuballocatorImpl::is_occupanc
     return std::visit([threshold](auto& suballoc) { return suballoc.is_occupancy_under(threshold); }, impl);
 }
 
+template <size_t BlockSize>
+std::span<std::byte> CollectiveAllocatorImpl<BlockSize>::SuballocatorImpl::block() noexcept
+{
+    if (auto* const per_page = std::get_if<PerPageSuballocator>(&impl)) {
+        return {reinterpret_cast<std::byte*>(per_page->p_arena->block_idx2head_ptr(per_page->block_idx)), BlockSize};
+    }
+    return {};
+}
+
 template <size_t BlockSize>
 template <size_t ElemSize, size_t Alignment>
 void* CollectiveAllocatorImpl<BlockSize>::allocate(const size_t n_elems)
@@ -145,6 +156,20 @@ constexpr bool Suballocator<T, BlockSize>::is_occupancy_under(double threshold)
 {
     return impl.is_occupancy_under(threshold);
 }
+template <class T, size_t BlockSize>
+void Suballocator<T, BlockSize>::set_block_priority(uint8_t priority) noexcept
+{
+    if (const auto block = impl.block(); !block.empty()) {
+        LocalMemoryStore::set_priority(block.data(), block.size(), priority);
+    }
+}
+template <class T, size_t BlockSize>
+void Suballocator<T, BlockSize>::mark_block_cold()
+{
+    if (const auto block = impl.block(); !block.empty()) {
+        LocalMemoryStore::mark_cold(block.data(), block.size());
+    }
+}
 
 template <class T, size_t BlockSize>
 [[nodiscard]] T* CollectiveAllocator<T, BlockSize>::allocate(size_t n)
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace FarMalloc
+{
+
+// Keeps the far copy of each page compressed in a process-wide pool.
+// All-zero pages occupy nothing and identical pages share one copy.
+struct CompressedStore : BackingStore {
+    struct Blob {
+        uint32_t ref_cnt;
+        uint32_t size;  // PageSize for pages stored uncompressed
+        uint64_t hash;
+
+        std::byte* data() noexcept { return reinterpret_cast<std::byte*>(this + 1); }
+    };
+
+    // size-segregated chunks carved from large mappings, in the spirit of zsmalloc
+    struct Pool {
+        inline static constexpr size_t ChunkGranularity = 64;
+        inline static constexpr size_t NClasses = (sizeof(Blob) + PageSize + ChunkGranularity - 1) / ChunkGranularity;
+        inline static constexpr size_t SpanSize = size_t{1} << 18;
+
+        struct FreeChunk {
+            FreeChunk* next;
+        };
+        std::array<FreeChunk*, NClasses> free_lists{};
+        std::byte* span_cursor = nullptr;
+        std::byte* span_end = nullptr;
+
+        inline Blob* allocate(size_t data_size);
+        inline void deallocate(Blob* blob) noexcept;
+    };
+
+    static bool enabled;
+    static std::mutex pool_mtx;
+    static Pool pool;
+    static std::unordered_map<uint64_t, Blob*> dedup_tab;
+
+    static std::atomic_uint64_t n_zero_pages;
+    static std::atomic_uint64_t n_shared_pages;
+    static std::atomic_uint64_t stored_bytes;
+    static std::atomic_uint64_t pool_bytes;
+
+    Blob** page_tab;
+
+    inline CompressedStore(size_t size);
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+
+    // every swappable arena created afterwards is backed by this store (unless a file or shared-memory store is open)
+    inline static void enable() noexcept { enabled = true; }
+    inline static void disable() noexcept { enabled = false; }
+    inline static bool is_enabled() noexcept { return enabled; }
+
+private:
+    inline bool load_page(size_t page_idx, std::byte* dst) noexcept;
+    inline bool store_page(size_t page_idx, const std::byte* src) noexcept;
+    inline static void release(Blob* blob) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/compressed_store.ipp>
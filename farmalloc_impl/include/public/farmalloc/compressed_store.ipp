@@ -0,0 +1,194 @@
+#pragma once
+
+#include <farmalloc/compressed_store.hpp>
+
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_codec.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <sys/mman.h>  // mmap
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+
+namespace FarMalloc
+{
+
+CompressedStore::Blob* CompressedStore::Pool::allocate(size_t data_size)
+{
+    const auto class_idx = (sizeof(Blob) + data_size + ChunkGranularity - 1) / ChunkGranularity - 1;
+    if (auto* const chunk = free_lists[class_idx]; chunk != nullptr) {
+        free_lists[class_idx] = chunk->next;
+        return reinterpret_cast<Blob*>(chunk);
+    }
+    const auto chunk_size = (class_idx + 1) * ChunkGranularity;
+    if (span_cursor == nullptr || static_cast<size_t>(span_end - span_cursor) < chunk_size) {
+        const auto mmap_result = mmap(NULL, SpanSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mmap_result == MAP_FAILED) [[unlikely]] {
+            return nullptr;
+        }
+        span_cursor = static_cast<std::byte*>(mmap_result);
+        span_end = span_cursor + SpanSize;
+        pool_bytes.fetch_add(SpanSize, std::memory_order_relaxed);
+    }
+    auto* const chunk = span_cursor;
+    span_cursor += chunk_size;
+    return reinterpret_cast<Blob*>(chunk);
+}
+void CompressedStore::Pool::deallocate(Blob* blob) noexcept
+{
+    const auto class_idx = (sizeof(Blob) + blob->size + ChunkGranularity - 1) / ChunkGranularity - 1;
+    auto* const chunk = reinterpret_cast<FreeChunk*>(blob);
+    chunk->next = free_lists[class_idx];
+    free_lists[class_idx] = chunk;
+}
+
+
+CompressedStore::CompressedStore(size_t size)
+{
+    assert(size % PageSize == 0);
+    page_tab = new Blob* [size / PageSize] {};
+}
+void CompressedStore::destroy(size_t size)
+{
+    for (size_t page_idx = 0; page_idx < size / PageSize; page_idx++) {
+        release(page_tab[page_idx]);
+    }
+    delete[] page_tab;
+}
+void CompressedStore::populate(const std::byte* src, size_t size)
+{
+    for (size_t page_idx = 0; page_idx < size / PageSize; page_idx++) {
+        if (!store_page(page_idx, src + page_idx * PageSize)) [[unlikely]] {
+            throw std::bad_alloc{};
+        }
+    }
+}
+void CompressedStore::discard(off_t off, size_t size) noexcept
+{
+    assert(off % PageSize == 0 && size % PageSize == 0);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t page_idx = first; page_idx < first + size / PageSize; page_idx++) {
+        release(std::exchange(page_tab[page_idx], nullptr));
+    }
+}
+
+ssize_t CompressedStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(off % PageSize == 0 && size_in_bytes % PageSize == 0);
+    LocalMemoryStore::read_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t i = 0; i < size_in_bytes / PageSize; i++) {
+        if (!load_page(first + i, reinterpret_cast<std::byte*>(buf) + i * PageSize)) [[unlikely]] {
+            return -1;
+        }
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+ssize_t CompressedStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(off % PageSize == 0 && size_in_bytes % PageSize == 0);
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t i = 0; i < size_in_bytes / PageSize; i++) {
+        if (!store_page(first + i, reinterpret_cast<const std::byte*>(buf) + i * PageSize)) [[unlikely]] {
+            return -1;
+        }
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+
+bool CompressedStore::load_page(size_t page_idx, std::byte* dst) noexcept
+{
+    auto* const blob = page_tab[page_idx];
+    if (blob == nullptr) {
+        std::memset(dst, 0, PageSize);
+        return true;
+    } else if (blob->size == PageSize) {
+        std::memcpy(dst, blob->data(), PageSize);
+        return true;
+    }
+    return PageCodec::decompress(blob->data(), blob->size, dst, PageSize);
+}
+bool CompressedStore::store_page(size_t page_idx, const std::byte* src) noexcept
+{
+    static_assert(PageSize % sizeof(uint64_t) == 0 && PageSize <= PageCodec::MaxInputSize);
+    uint64_t any = 0, hash = 0xcbf29ce484222325u;
+    for (size_t pos = 0; pos < PageSize; pos += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, src + pos, sizeof(word));
+        any |= word;
+        hash = std::rotl((hash ^ word) * 0x100000001b3u, 29);
+    }
+    auto* const old = page_tab[page_idx];
+    if (any == 0) {
+        page_tab[page_idx] = nullptr;
+        release(old);
+        n_zero_pages.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // compressing by less than 1/8 is not worth the decompression on every fault
+    alignas(uint64_t) thread_local std::byte compressed[PageSize];
+    auto size = PageCodec::compress(src, PageSize, compressed, PageSize - PageSize / 8);
+    const std::byte* data = compressed;
+    if (size == 0) {
+        size = PageSize;
+        data = src;
+    }
+
+    Blob* blob;
+    {
+        std::lock_guard lk{pool_mtx};
+        if (const auto it = dedup_tab.find(hash); it != dedup_tab.end() && it->second->size == size && std::memcmp(it->second->data(), data, size) == 0) {
+            blob = it->second;
+            blob->ref_cnt++;
+            n_shared_pages.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            blob = pool.allocate(size);
+            if (blob == nullptr) [[unlikely]] {
+                return false;
+            }
+            blob->ref_cnt = 1;
+            blob->size = static_cast<uint32_t>(size);
+            blob->hash = hash;
+            std::memcpy(blob->data(), data, size);
+            if (it == dedup_tab.end()) {
+                try {
+                    dedup_tab.emplace(hash, blob);
+                } catch (...) {  // the page just does not take part in deduplication
+                }
+            }
+            stored_bytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+    page_tab[page_idx] = blob;
+    release(old);
+    return true;
+}
+void CompressedStore::release(Blob* blob) noexcept
+{
+    if (blob == nullptr) {
+        return;
+    }
+    std::lock_guard lk{pool_mtx};
+    if (--blob->ref_cnt != 0) {
+        return;
+    }
+    if (const auto it = dedup_tab.find(blob->hash); it != dedup_tab.end() && it->second == blob) {
+        dedup_tab.erase(it);
+    }
+    stored_bytes.fetch_sub(blob->size, std::memory_order_relaxed);
+    pool.deallocate(blob);
+}
+
+}  // namespace FarMalloc
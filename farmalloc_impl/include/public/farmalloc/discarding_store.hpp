@@ -0,0 +1,44 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/page_bitmap.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <atomic>
+#include <cstddef>
+
+
+namespace FarMalloc
+{
+
+// Decorator at the top of every swappable region's store that remembers which pages the allocator has freed.
+// Until the allocator hands a page out again, its writebacks are dropped and its faults are zero-filled
+// without touching the wrapped store, which is told to release its copy.
+struct DiscardingStore : BackingStore {
+    static std::atomic_uint64_t n_discarded_pages;
+    static std::atomic_uint64_t n_skipped_reads;
+    static std::atomic_uint64_t n_skipped_writes;
+
+    BackingStore* inner;
+    size_t n_pages;
+    PageBitmap dead;
+
+    inline DiscardingStore(BackingStore* inner, size_t size);
+    inline void destroy(size_t size) override { inner->destroy(size); }
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+
+    // the allocator is handing [off, off + size) out again; every page it touches is live from now on
+    inline void reuse(off_t off, size_t size) noexcept;
+
+private:
+    inline bool is_dead(off_t off, size_t size) const noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/discarding_store.ipp>
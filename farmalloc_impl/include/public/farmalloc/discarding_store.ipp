@@ -0,0 +1,59 @@
+#pragma once
+
+#include <farmalloc/discarding_store.hpp>
+
+#include <farmalloc/page_size.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+
+namespace FarMalloc
+{
+
+DiscardingStore::DiscardingStore(BackingStore* inner, size_t size)
+    : inner{inner}, n_pages{(size + PageSize - 1) / PageSize}, dead{n_pages} {}
+void DiscardingStore::populate(const std::byte* src, size_t size)
+{
+    dead.assign(0, n_pages, false);  // everything is rewritten
+    inner->populate(src, size);
+}
+void DiscardingStore::discard(off_t off, size_t size) noexcept
+{
+    const auto first_page = static_cast<size_t>(off) / PageSize;
+    dead.assign(first_page, first_page + size / PageSize, true);
+    n_discarded_pages.fetch_add(size / PageSize, std::memory_order_relaxed);
+    inner->discard(off, size);
+}
+
+ssize_t DiscardingStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    if (is_dead(off, size_in_bytes)) {
+        n_skipped_reads.fetch_add(1, std::memory_order_relaxed);
+        std::memset(buf, 0, size_in_bytes);
+        return static_cast<ssize_t>(size_in_bytes);
+    }
+    return inner->read_from_store(buf, size_in_bytes, off);
+}
+ssize_t DiscardingStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    if (is_dead(off, size_in_bytes)) {
+        n_skipped_writes.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<ssize_t>(size_in_bytes);
+    }
+    return inner->write_to_store(buf, size_in_bytes, off);
+}
+
+void DiscardingStore::reuse(off_t off, size_t size) noexcept
+{
+    dead.assign(static_cast<size_t>(off) / PageSize, (static_cast<size_t>(off) + size + PageSize - 1) / PageSize, false);
+}
+
+
+bool DiscardingStore::is_dead(off_t off, size_t size) const noexcept
+{
+    return dead.all(static_cast<size_t>(off) / PageSize, (static_cast<size_t>(off) + size + PageSize - 1) / PageSize);
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+// timing characteristics of an emulated far-memory fabric
+struct FabricModel {
+    std::chrono::nanoseconds read_latency;
+    std::chrono::nanoseconds write_latency;
+    double bytes_per_second;  // shared by all the transfers; 0 for unlimited
+    unsigned queue_depth;     // maximum number of concurrent transfers; 0 for unlimited
+
+    // rough figures; measure the real hardware when it matters
+    inline static constexpr FabricModel cxl() noexcept { return {std::chrono::nanoseconds{300}, std::chrono::nanoseconds{300}, 32e9, 0}; }
+    inline static constexpr FabricModel rdma() noexcept { return {std::chrono::microseconds{3}, std::chrono::microseconds{3}, 12.5e9, 64}; }
+    inline static constexpr FabricModel nvme_ssd() noexcept { return {std::chrono::microseconds{80}, std::chrono::microseconds{20}, 3e9, 32}; }
+};
+
+// Decorator that makes every transfer of the wrapped store take at least as long as it would on the modeled fabric:
+// transfers wait for a free queue slot, are serialized on the shared link according to the bandwidth,
+// and complete no earlier than the latency after they started.
+struct EmulatedStore : BackingStore {
+    using Clock = std::chrono::steady_clock;
+
+    static bool enabled;
+    static FabricModel model;
+
+    static std::mutex queue_mtx;
+    static std::condition_variable queue_cv;
+    static unsigned n_in_flight;
+    static std::atomic<Clock::rep> link_free_at;
+    static std::atomic_uint64_t injected_ns;
+
+    BackingStore* inner;
+
+    inline explicit EmulatedStore(BackingStore* inner) noexcept : inner{inner} {}
+    inline void destroy(size_t size) override { inner->destroy(size); }
+    inline void populate(const std::byte* src, size_t size) override { inner->populate(src, size); }
+    inline void discard(off_t off, size_t size) noexcept override { inner->discard(off, size); }
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    // one transfer: the latency is paid once for the whole run
+    inline ssize_t write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept override;
+
+    // every swappable arena created afterwards has its store wrapped
+    inline static void enable(const FabricModel& fabric) noexcept;
+    inline static void disable() noexcept { enabled = false; }
+    inline static bool is_enabled() noexcept { return enabled; }
+
+private:
+    template <class Transfer>
+    inline static ssize_t emulate(std::chrono::nanoseconds latency, size_t size_in_bytes, Transfer&& transfer) noexcept;
+    inline static void wait_until(Clock::time_point deadline) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/emulated_store.ipp>
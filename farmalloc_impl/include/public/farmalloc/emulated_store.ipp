@@ -0,0 +1,88 @@
+#pragma once
+
+#include <farmalloc/emulated_store.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+
+namespace FarMalloc
+{
+
+ssize_t EmulatedStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    return emulate(model.read_latency, size_in_bytes, [&] { return inner->read_from_store(buf, size_in_bytes, off); });
+}
+ssize_t EmulatedStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    return emulate(model.write_latency, size_in_bytes, [&] { return inner->write_to_store(buf, size_in_bytes, off); });
+}
+ssize_t EmulatedStore::write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept
+{
+    size_t size_in_bytes = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        size_in_bytes += iov[i].iov_len;
+    }
+    return emulate(model.write_latency, size_in_bytes, [&] { return inner->write_vectored(iov, iovcnt, off); });
+}
+
+void EmulatedStore::enable(const FabricModel& fabric) noexcept
+{
+    model = fabric;
+    link_free_at.store(0, std::memory_order_relaxed);
+    enabled = true;
+}
+
+template <class Transfer>
+ssize_t EmulatedStore::emulate(std::chrono::nanoseconds latency, size_t size_in_bytes, Transfer&& transfer) noexcept
+{
+    if (model.queue_depth != 0) {
+        std::unique_lock lk{queue_mtx};
+        queue_cv.wait(lk, [] { return n_in_flight < model.queue_depth; });
+        n_in_flight++;
+    }
+
+    const auto start = Clock::now();
+    auto complete_at = start + latency;
+    if (model.bytes_per_second > 0) {
+        // occupy the link from when it becomes free until the transfer has gone through
+        const auto transfer_time = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>{static_cast<double>(size_in_bytes) / model.bytes_per_second});
+        auto free_at = link_free_at.load(std::memory_order_relaxed);
+        Clock::rep done_at;
+        do {
+            done_at = std::max(free_at, start.time_since_epoch().count()) + transfer_time.count();
+        } while (!link_free_at.compare_exchange_weak(free_at, done_at, std::memory_order_relaxed));
+        complete_at += Clock::time_point{Clock::duration{done_at}} - start;
+    }
+
+    const auto res = std::forward<Transfer>(transfer)();
+    if (const auto now = Clock::now(); now < complete_at) {
+        injected_ns.fetch_add(static_cast<uint64_t>(std::chrono::nanoseconds{complete_at - now}.count()), std::memory_order_relaxed);
+        wait_until(complete_at);
+    }
+
+    if (model.queue_depth != 0) {
+        std::lock_guard lk{queue_mtx};
+        n_in_flight--;
+        queue_cv.notify_one();
+    }
+    return res;
+}
+void EmulatedStore::wait_until(Clock::time_point deadline) noexcept
+{
+    // sleeping overshoots by tens of microseconds, so only the bulk of long waits is slept
+    constexpr auto SpinThreshold = std::chrono::microseconds{100};
+    if (deadline - Clock::now() > SpinThreshold) {
+        std::this_thread::sleep_until(deadline - SpinThreshold / 2);
+    }
+    while (Clock::now() < deadline) {
+    }
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <farmalloc/arena_registry.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+// Threads that run the batches of work handed to them, started as a batch first needs them and kept afterwards.
+struct WorkerPool {
+    std::mutex run_mtx;  // one batch at a time
+    std::mutex mtx;
+    std::condition_variable_any cv;  // wakes the workers for a batch, and the caller as they finish it
+    const std::function<void()>* task = nullptr;
+    uint64_t batch = 0;
+    unsigned n_wanted = 0;   // workers still to join the current batch
+    unsigned n_running = 0;  // workers inside `task`
+    std::vector<std::jthread> threads;  // last, so that they are stopped and joined before the rest goes
+
+    // run `task` on the calling thread and on up to `n_helpers` workers; returns once every one of them has returned.
+    // Workers that have not picked the batch up when the caller's share returns are not waited for.
+    inline void run(unsigned n_helpers, const std::function<void()>& task);
+
+private:
+    inline void work(std::stop_token stop);
+};
+
+// A set of swappable regions that enter and leave far-memory mode together.
+// Every allocator registers its arenas in a group (default_group unless told otherwise),
+// so e.g. a latency-critical container can stay local while bulk ones are paged out.
+struct FarMemoryGroup {
+    static FarMemoryGroup default_group;
+    // number of groups in far-memory mode, so that hints can be dropped cheaply while everything is local
+    static std::atomic_size_t n_far_groups;
+    // the helper threads of every mode_change_step
+    static WorkerPool workers;
+
+    // held exclusively by a step of a mode change, shared by umap/uunmap of the group's regions
+    std::shared_mutex mode_mtx;
+    bool far_memory_mode = false;
+    uintptr_t mode_change_cursor = 0;
+    // where the group's regions start; changed by umap/uunmap under a shared mode_mtx, so a mode change step reads it freely
+    std::mutex regions_mtx;
+    std::set<uintptr_t> regions;
+
+    inline FarMemoryGroup() noexcept = default;
+    FarMemoryGroup(const FarMemoryGroup&) = delete;
+    FarMemoryGroup& operator=(const FarMemoryGroup&) = delete;
+
+    inline bool is_far() noexcept;
+
+    // flip far_memory_mode; new regions follow it at once, registered ones are converted by mode_change_step
+    inline bool begin_mode_change();
+    // convert registered regions to the current mode on `n_threads` threads for roughly `budget`
+    // returns whether every region has been converted
+    // a region is copied, dropped and remapped in place, so no thread may touch the group's memory (nor allocate or free in it) while a step runs:
+    // a store after the copy would be lost, and a touch before the remap would install a page the pager never fills;
+    // the service may run between steps, where every region is wholly in one mode or the other
+    inline bool mode_change_step(std::chrono::nanoseconds budget, unsigned n_threads = std::thread::hardware_concurrency());
+    inline bool mode_change(unsigned n_threads = std::thread::hardware_concurrency());
+
+private:
+    inline static void convert_region(const RegionEntry& entry, bool far);
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/far_memory_group.ipp>
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <farmalloc/far_memory_group.hpp>
+
+#include <farmalloc/arena_registry.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/pager.hpp>
+
+#include <errno.h>     // errno
+#include <sys/mman.h>  // madvise
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+
+
+namespace FarMalloc
+{
+
+void WorkerPool::run(unsigned n_helpers, const std::function<void()>& task)
+{
+    std::lock_guard run_lock{run_mtx};
+    {
+        std::lock_guard lock{mtx};
+        while (threads.size() < n_helpers) {
+            threads.emplace_back([this](std::stop_token stop) { work(stop); });
+        }
+        this->task = &task;
+        batch++;
+        n_wanted = n_helpers;
+    }
+    cv.notify_all();
+    task();
+    std::unique_lock lock{mtx};
+    n_wanted = 0;
+    cv.wait(lock, [this] { return n_running == 0; });
+    this->task = nullptr;
+}
+void WorkerPool::work(std::stop_token stop)
+{
+    uint64_t last_batch = 0;
+    std::unique_lock lock{mtx};
+    while (cv.wait(lock, stop, [&] { return n_wanted > 0 && batch != last_batch; })) {
+        last_batch = batch;
+        n_wanted--;
+        n_running++;
+        const auto* const current = task;
+        lock.unlock();
+        (*current)();
+        lock.lock();
+        if (--n_running == 0) {
+            cv.notify_all();
+        }
+    }
+}
+
+
+bool FarMemoryGroup::is_far() noexcept
+{
+    std::shared_lock lock{mode_mtx};
+    return far_memory_mode;
+}
+
+bool FarMemoryGroup::begin_mode_change()
+{
+    std::unique_lock lock{mode_mtx};
+    far_memory_mode = !far_memory_mode;
+    mode_change_cursor = 0;
+    if (far_memory_mode) {
+        Pager::adopt_page_size();
+        n_far_groups.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        n_far_groups.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return far_memory_mode;
+}
+bool FarMemoryGroup::mode_change_step(std::chrono::nanoseconds budget, unsigned n_threads)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = budget == std::chrono::nanoseconds::max() ? Clock::time_point::max() : Clock::now() + budget;
+
+    std::unique_lock lock{mode_mtx};
+    const bool far = far_memory_mode;
+    std::mutex claim_mtx;
+    bool exhausted = false;
+    std::exception_ptr error;
+    // each worker converts at least one region, so every step makes progress
+    const auto work = [&] {
+        try {
+            do {
+                std::optional<RegionEntry> entry;
+                {
+                    std::lock_guard claim_lock{claim_mtx};
+                    if (exhausted || error) {
+                        return;
+                    }
+                    do {
+                        const auto next = regions.lower_bound(mode_change_cursor);
+                        if (next == regions.end()) {
+                            exhausted = true;
+                            return;
+                        }
+                        mode_change_cursor = *next + 1;
+                        entry = LocalMemoryStore::mapping.find(reinterpret_cast<void*>(*next));
+                    } while (!entry || entry->far == far);
+                }
+                convert_region(*entry, far);
+            } while (Clock::now() < deadline);
+        } catch (...) {
+            std::lock_guard claim_lock{claim_mtx};
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+    workers.run(std::max(n_threads, 1u) - 1, work);
+    if (error) [[unlikely]] {
+        // rescan from the beginning on the next step; the failed region is still in the old mode
+        mode_change_cursor = 0;
+        std::rethrow_exception(error);
+    }
+    return exhausted;
+}
+bool FarMemoryGroup::mode_change(unsigned n_threads)
+{
+    const bool far = begin_mode_change();
+    while (!mode_change_step(std::chrono::nanoseconds::max(), n_threads)) {
+    }
+    return far;
+}
+
+void FarMemoryGroup::convert_region(const RegionEntry& entry, bool far)
+{
+    if (far) {
+        entry.store->populate(static_cast<const std::byte*>(entry.ptr), entry.size);
+        if (madvise(entry.ptr, entry.size, MADV_DONTNEED) != 0) {
+            throw std::system_error{errno, std::generic_category(), "madvise(MADV_DONTNEED)"};
+        }
+        Pager::map(entry.ptr, entry.size, entry.store);
+    } else {
+        Pager::unmap(entry.ptr, entry.size);
+    }
+    LocalMemoryStore::mapping.set_far(entry.ptr, entry.size, far);
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/fault_trace_format.hpp>
+#include <farmalloc/store_stats.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+namespace FarMalloc
+{
+
+// Opt-in record of every read and write that reaches the stores of swappable arenas, kept in a ring of the most recent records
+// and dumped to a file for farmalloc_trace_sim to replay against other cache sizes and eviction policies.
+// Appending takes one fetch_add and a 24-byte store, so tracing can stay on under production load.
+struct FaultTrace {
+    using Record = FaultTraceFormat::Record;
+
+    static bool enabled;
+    static std::unique_ptr<Record[]> ring;
+    static size_t capacity;  // a power of two
+    static std::atomic_uint64_t n_appended;
+    static std::atomic_uint32_t n_arenas;
+    static std::atomic_uint16_t current_tag;
+    static std::chrono::steady_clock::time_point epoch;
+
+    // Tags the store operations issued while it lives, e.g. with the kind of container operation in progress.
+    // The tag is process-wide rather than per thread since those operations run on the pager's threads;
+    // tags of concurrent operations on different threads overwrite each other.
+    struct ScopedTag {
+        uint16_t saved;
+
+        inline explicit ScopedTag(uint16_t tag) noexcept : saved{current_tag.exchange(tag, std::memory_order_relaxed)} {}
+        ScopedTag(const ScopedTag&) = delete;
+        ScopedTag& operator=(const ScopedTag&) = delete;
+        inline ~ScopedTag() { current_tag.store(saved, std::memory_order_relaxed); }
+    };
+
+    // stores of swappable arenas created afterwards are traced; the ring of `capacity` records (rounded up to a power of two)
+    // is allocated by the first call and kept afterwards
+    inline static void enable(size_t capacity = size_t{1} << 20);
+    inline static void disable() noexcept { enabled = false; }
+    inline static bool is_enabled() noexcept { return enabled; }
+
+    inline static void append(uint32_t arena, ArenaKind kind, FaultTraceFormat::Op op, off_t off, size_t size) noexcept;
+    // write the records still in the ring, oldest first; no traced store may be in use meanwhile
+    inline static void dump(const char* path);
+};
+
+
+// Decorator appending the operations that pass through it to FaultTrace; sits just inside the statistics decorator.
+struct TracingStore : BackingStore {
+    BackingStore* inner;
+    uint32_t arena;
+    ArenaKind kind;
+
+    inline TracingStore(BackingStore* inner, ArenaKind kind) noexcept
+        : inner{inner}, arena{FaultTrace::n_arenas.fetch_add(1, std::memory_order_relaxed)}, kind{kind} {}
+    inline void destroy(size_t size) override { inner->destroy(size); }
+    inline void populate(const std::byte* src, size_t size) override { inner->populate(src, size); }
+    inline void discard(off_t off, size_t size) noexcept override { inner->discard(off, size); }
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/fault_trace.ipp>
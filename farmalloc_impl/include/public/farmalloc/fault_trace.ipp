@@ -0,0 +1,85 @@
+#pragma once
+
+#include <farmalloc/fault_trace.hpp>
+
+#include <farmalloc/page_size.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <system_error>
+
+
+namespace FarMalloc
+{
+
+void FaultTrace::enable(size_t capacity)
+{
+    if (!ring) {
+        FaultTrace::capacity = std::bit_ceil(std::max(capacity, size_t{1}));
+        ring = std::make_unique<Record[]>(FaultTrace::capacity);
+        epoch = std::chrono::steady_clock::now();
+    }
+    enabled = true;
+}
+
+void FaultTrace::append(uint32_t arena, ArenaKind kind, FaultTraceFormat::Op op, off_t off, size_t size) noexcept
+{
+    const auto now = std::chrono::steady_clock::now();
+    const auto idx = n_appended.fetch_add(1, std::memory_order_relaxed);
+    ring[idx & (capacity - 1)] = Record{
+        .time_ns = static_cast<uint64_t>(std::chrono::nanoseconds{now - epoch}.count()),
+        .arena = arena,
+        .page = static_cast<uint32_t>(static_cast<size_t>(off) / PageSize),
+        .n_pages = static_cast<uint32_t>((static_cast<size_t>(off) % PageSize + size + PageSize - 1) / PageSize),
+        .tag = current_tag.load(std::memory_order_relaxed),
+        .op = op,
+        .kind = static_cast<uint8_t>(kind),
+    };
+}
+
+void FaultTrace::dump(const char* path)
+{
+    const auto total = n_appended.load(std::memory_order_acquire);
+    const auto n_records = ring ? std::min<uint64_t>(total, capacity) : 0;
+    const FaultTraceFormat::Header header{
+        .magic = FaultTraceFormat::Magic,
+        .page_size = static_cast<uint32_t>(PageSize),
+        .record_size = sizeof(Record),
+        .n_records = n_records,
+        .n_lost = total - n_records,
+    };
+
+    const std::unique_ptr<std::FILE, int (*)(std::FILE*)> file{std::fopen(path, "wb"), std::fclose};
+    if (!file) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "open fault trace"};
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, file.get()) == 1;
+    if (n_records > 0) {
+        // oldest first: from the slot the next record would overwrite, around the ring
+        const auto first = static_cast<size_t>(total - n_records) & (capacity - 1);
+        const auto n_tail = std::min(static_cast<size_t>(n_records), capacity - first),
+                   n_head = static_cast<size_t>(n_records) - n_tail;
+        ok = ok && std::fwrite(ring.get() + first, sizeof(Record), n_tail, file.get()) == n_tail;
+        ok = ok && std::fwrite(ring.get(), sizeof(Record), n_head, file.get()) == n_head;
+    }
+    if (!ok || std::fflush(file.get()) != 0) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "write fault trace"};
+    }
+}
+
+
+ssize_t TracingStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    FaultTrace::append(arena, kind, FaultTraceFormat::Op::read, off, size_in_bytes);
+    return inner->read_from_store(buf, size_in_bytes, off);
+}
+ssize_t TracingStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    FaultTrace::append(arena, kind, FaultTraceFormat::Op::write, off, size_in_bytes);
+    return inner->write_to_store(buf, size_in_bytes, off);
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+
+// File format of the traces written by FaultTrace::dump and replayed by farmalloc_trace_sim:
+// a Header followed by `n_records` Records, oldest first, in the byte order of the machine that wrote them.
+namespace FarMalloc::FaultTraceFormat
+{
+
+inline constexpr uint64_t Magic = 0x3145434152544d46;  // "FMTRACE1"
+
+enum class Op : uint8_t {
+    read,   // a fault: the pages were read from the store
+    write,  // a writeback: the pages were written to the store
+};
+
+struct Header {
+    uint64_t magic;
+    uint32_t page_size;
+    uint32_t record_size;
+    uint64_t n_records;
+    uint64_t n_lost;  // older records overwritten in the ring before the dump
+};
+
+struct Record {
+    uint64_t time_ns;  // since tracing was first enabled
+    uint32_t arena;    // numbered in order of creation
+    uint32_t page;     // first page, from the start of the arena
+    uint32_t n_pages;
+    uint16_t tag;  // FaultTrace::ScopedTag in force
+    Op op;
+    uint8_t kind;  // ArenaKind of the arena
+};
+static_assert(sizeof(Record) == 24);
+
+}  // namespace FarMalloc::FaultTraceFormat
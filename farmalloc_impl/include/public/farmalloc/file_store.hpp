@@ -0,0 +1,61 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <cstddef>
+
+#include <map>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+// Keeps the far copy of each region in its own extent of a shared backing file or block device.
+// Once `open` has been called, every swappable arena created afterwards is backed by this store.
+struct FileStore : BackingStore {
+    static int fd;
+    static bool direct_io;
+    static off_t capacity;
+
+    static std::mutex extents_mtx;
+    static off_t file_tail;
+    static std::map<off_t, size_t> free_extents;  // offset -> size, coalesced with their neighbours
+    static std::multimap<size_t, off_t> free_sizes;  // size -> offset, for best fit
+
+    off_t base;
+
+    inline FileStore(size_t size);
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept override;
+
+    // `path` may name a regular file, a block device, or a directory (then an unnamed temporary file is created in it)
+    inline static void open(const char* path, bool direct = false);
+    inline static void close();
+    inline static bool is_open() noexcept { return fd != -1; }
+
+protected:
+    // transfer the whole range, retrying on EINTR and short transfers; -1 on failure
+    inline static ssize_t pread_all(char* buf, size_t size, off_t pos) noexcept;
+    inline static ssize_t pwrite_all(const char* buf, size_t size, off_t pos) noexcept;
+
+private:
+    inline static off_t allocate_extent(size_t size);
+    inline static void deallocate_extent(off_t extent, size_t size) noexcept;
+    inline static void insert_free_extent(off_t extent, size_t size);
+    inline static void erase_free_extent(std::map<off_t, size_t>::iterator it) noexcept;
+    // punch a hole, or at least make the range read back as zeros (block devices may support neither); false on failure
+    inline static bool zero_range(off_t pos, size_t size) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/file_store.ipp>
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <farmalloc/file_store.hpp>
+
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <errno.h>      // errno
+#include <fcntl.h>      // open, fallocate, O_*
+#include <linux/fs.h>   // BLKGETSIZE64
+#include <sys/ioctl.h>  // ioctl
+#include <sys/stat.h>   // fstat, stat
+#include <sys/uio.h>    // pwritev
+#include <unistd.h>     // close, ftruncate, pread, pwrite
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+
+namespace FarMalloc
+{
+
+FileStore::FileStore(size_t size) : base{allocate_extent(size)} {}
+void FileStore::destroy(size_t size)
+{
+    deallocate_extent(base, size);
+}
+void FileStore::populate(const std::byte* src, size_t size)
+{
+    if (pwrite_all(reinterpret_cast<const char*>(src), size, base) == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "pwrite"};
+    }
+}
+void FileStore::discard(off_t off, size_t size) noexcept
+{
+    // failure (e.g. on block devices) only costs space: a discarded page may keep its dead contents,
+    // unlike a freed extent, which zero_range clears before another region can reuse it
+    fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, base + off, static_cast<off_t>(size));
+}
+
+ssize_t FileStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(!direct_io || (reinterpret_cast<uintptr_t>(buf) % PageSize == 0 && size_in_bytes % PageSize == 0 && off % PageSize == 0));
+    LocalMemoryStore::read_cnt.fetch_add(1, std::memory_order_relaxed);
+    return pread_all(buf, size_in_bytes, base + off);
+}
+ssize_t FileStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(!direct_io || (reinterpret_cast<uintptr_t>(buf) % PageSize == 0 && size_in_bytes % PageSize == 0 && off % PageSize == 0));
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    return pwrite_all(buf, size_in_bytes, base + off);
+}
+ssize_t FileStore::write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept
+{
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        assert(!direct_io || (reinterpret_cast<uintptr_t>(iov[i].iov_base) % PageSize == 0 && iov[i].iov_len % PageSize == 0));
+        total += iov[i].iov_len;
+    }
+    const auto res = pwritev(fd, iov, iovcnt, base + off);
+    if (res == static_cast<ssize_t>(total)) {
+        return res;
+    } else if (res == -1 && errno != EINTR) [[unlikely]] {
+        return -1;
+    }
+
+    // interrupted or short: finish buffer by buffer
+    auto done = static_cast<size_t>(std::max<ssize_t>(res, 0));
+    size_t pos = 0;
+    for (int i = 0; i < iovcnt; pos += iov[i].iov_len, i++) {
+        if (pos + iov[i].iov_len <= done) {
+            continue;
+        }
+        const auto skip = done > pos ? done - pos : 0;
+        if (pwrite_all(static_cast<const char*>(iov[i].iov_base) + skip, iov[i].iov_len - skip, base + off + static_cast<off_t>(pos + skip)) == -1) [[unlikely]] {
+            return -1;
+        }
+    }
+    return static_cast<ssize_t>(total);
+}
+
+ssize_t FileStore::pread_all(char* buf, size_t size, off_t pos) noexcept
+{
+    for (size_t done = 0; done < size;) {
+        const auto res = pread(fd, buf + done, size - done, pos + static_cast<off_t>(done));
+        if (res == -1) [[unlikely]] {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        } else if (res == 0) [[unlikely]] {  // beyond the end of the file: never written yet
+            std::memset(buf + done, 0, size - done);
+            break;
+        }
+        done += static_cast<size_t>(res);
+    }
+    return static_cast<ssize_t>(size);
+}
+ssize_t FileStore::pwrite_all(const char* buf, size_t size, off_t pos) noexcept
+{
+    for (size_t done = 0; done < size;) {
+        const auto res = pwrite(fd, buf + done, size - done, pos + static_cast<off_t>(done));
+        if (res == -1) [[unlikely]] {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += static_cast<size_t>(res);
+    }
+    return static_cast<ssize_t>(size);
+}
+
+
+void FileStore::open(const char* path, bool direct)
+{
+    if (is_open()) {
+        throw std::logic_error{"FileStore is already open"};
+    }
+    const int flags = O_RDWR | O_CLOEXEC | (direct ? O_DIRECT : 0);
+
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        fd = ::open(path, flags | O_TMPFILE, S_IRUSR | S_IWUSR);
+    } else {
+        fd = ::open(path, flags | O_CREAT, S_IRUSR | S_IWUSR);
+    }
+    if (fd == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "open"};
+    }
+    if (fstat(fd, &st) == -1) [[unlikely]] {
+        const auto err = errno;
+        ::close(fd);
+        fd = -1;
+        throw std::system_error{err, std::generic_category(), "fstat"};
+    }
+
+    if (S_ISBLK(st.st_mode)) {
+        uint64_t dev_size;
+        if (ioctl(fd, BLKGETSIZE64, &dev_size) == -1) [[unlikely]] {
+            const auto err = errno;
+            ::close(fd);
+            fd = -1;
+            throw std::system_error{err, std::generic_category(), "ioctl(BLKGETSIZE64)"};
+        }
+        capacity = static_cast<off_t>(dev_size / PageSize * PageSize);
+    } else {
+        capacity = std::numeric_limits<off_t>::max();
+    }
+    direct_io = direct;
+    file_tail = 0;
+    free_extents.clear();
+    free_sizes.clear();
+}
+void FileStore::close()
+{
+    if (is_open()) {
+        if (::close(fd) == -1) [[unlikely]] {
+            throw std::system_error{errno, std::generic_category(), "close"};
+        }
+        fd = -1;
+    }
+}
+
+off_t FileStore::allocate_extent(size_t size)
+{
+    assert(is_open() && size % PageSize == 0);
+    std::unique_lock lk{extents_mtx};
+
+    if (const auto it = free_sizes.lower_bound(size); it != free_sizes.end()) {
+        const auto [extent_size, extent] = *it;
+        erase_free_extent(free_extents.find(extent));
+        if (extent_size != size) {
+            try {
+                insert_free_extent(extent + static_cast<off_t>(size), extent_size - size);
+            } catch (...) {  // losing track of the rest only leaks file space
+            }
+        }
+        return extent;  // zeroed when it was freed
+    }
+
+    if (capacity - file_tail < static_cast<off_t>(size)) [[unlikely]] {
+        throw std::bad_alloc{};
+    }
+    const auto extent = file_tail;
+    file_tail += static_cast<off_t>(size);
+    if (capacity == std::numeric_limits<off_t>::max()) {  // regular file: extend sparsely so that reads never hit EOF
+        if (ftruncate(fd, file_tail) == -1) [[unlikely]] {
+            file_tail = extent;
+            throw std::system_error{errno, std::generic_category(), "ftruncate"};
+        }
+    } else {  // block device: whatever was written there before must not leak into the region
+        lk.unlock();
+        if (!zero_range(extent, size)) [[unlikely]] {
+            const auto err = errno;
+            deallocate_extent(extent, size);
+            throw std::system_error{err, std::generic_category(), "zero_range"};
+        }
+    }
+    return extent;
+}
+void FileStore::deallocate_extent(off_t extent, size_t size) noexcept
+{
+    // give the blocks back to the file system; if even zeroing fails, the extent is leaked rather than reused with stale data
+    if (!zero_range(extent, size)) [[unlikely]] {
+        return;
+    }
+
+    std::lock_guard lk{extents_mtx};
+    if (const auto next = free_extents.find(extent + static_cast<off_t>(size)); next != free_extents.end()) {
+        size += next->second;
+        erase_free_extent(next);
+    }
+    if (const auto next = free_extents.lower_bound(extent); next != free_extents.begin()) {
+        if (const auto prev = std::prev(next); prev->first + static_cast<off_t>(prev->second) == extent) {
+            extent = prev->first;
+            size += prev->second;
+            erase_free_extent(prev);
+        }
+    }
+
+    if (extent + static_cast<off_t>(size) == file_tail) {  // hand the end of the file back instead of keeping it as an extent
+        file_tail = extent;
+        if (capacity == std::numeric_limits<off_t>::max()) {
+            ftruncate(fd, file_tail);  // failure only keeps the file long
+        }
+        return;
+    }
+    try {
+        insert_free_extent(extent, size);
+    } catch (...) {  // losing track of the extent only leaks file space
+    }
+}
+void FileStore::insert_free_extent(off_t extent, size_t size)
+{
+    const auto it = free_extents.emplace(extent, size).first;
+    try {
+        free_sizes.emplace(size, extent);
+    } catch (...) {
+        free_extents.erase(it);
+        throw;
+    }
+}
+void FileStore::erase_free_extent(std::map<off_t, size_t>::iterator it) noexcept
+{
+    auto [first, last] = free_sizes.equal_range(it->second);
+    for (; first != last; ++first) {
+        if (first->second == it->first) {
+            free_sizes.erase(first);
+            break;
+        }
+    }
+    free_extents.erase(it);
+}
+bool FileStore::zero_range(off_t pos, size_t size) noexcept
+{
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, pos, static_cast<off_t>(size)) == 0
+        || fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, pos, static_cast<off_t>(size)) == 0) {
+        return true;
+    }
+
+    // write the zeros ourselves, aligned for O_DIRECT
+    alignas(PageSize) static const char zeros[16 * PageSize] = {};
+    for (size_t done = 0; done < size; done += sizeof(zeros)) {
+        if (pwrite_all(zeros, std::min(sizeof(zeros), size - done), pos + static_cast<off_t>(done)) == -1) [[unlikely]] {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace FarMalloc
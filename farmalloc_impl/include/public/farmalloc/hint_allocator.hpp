@@ -1,9 +1,12 @@
 #pragma once
 
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/far_memory_group.hpp>
 #include <farmalloc/local_memory_store.hpp>
 #include <farmalloc/per-page_suballocator.hpp>  // KRFreeHeader
 #include <farmalloc/size_class.hpp>
+#include <farmalloc/store_buffer.hpp>
+#include <farmalloc/store_factory.hpp>
 #include <util/enough_unsigned_integer.hpp>
 
 #include <array>
@@ -85,7 +88,7 @@ struct HintAllocArenaMetadata {
     Link link;
     size_t num_of_used_blocks;
     std::array<uint64_t, (NBlocks + 63) / 64> is_block_used;
-    LocalMemoryStoreBuffer store_buf;
+    StoreBuffer store_buf;
     std::array<Block, NBlocks> blocks_tab;
 };
 
@@ -107,10 +110,10 @@ struct HintAllocArena : HintAllocArenaMetadata<BlockSize, NBlocksForHintAllocAre
     constexpr Block& block(size_t idx) noexcept { return this->blocks_tab[idx]; }
 
 protected:
-    inline HintAllocArena();
+    inline HintAllocArena(FarMemoryGroup& group, StoreFactory factory);
 
 public:
-    inline static HintAllocArena& create();
+    inline static HintAllocArena& create(FarMemoryGroup& group, StoreFactory factory);
     HintAllocArena(const HintAllocArena&) = delete;
 
     ~HintAllocArena();
@@ -137,9 +140,14 @@ struct HintAllocatorImpl {
     ArenaLink non_full_arenas{&non_full_arenas, &non_full_arenas};
     size_t current_block_idx;
     BlockLink non_full_blocks{&non_full_blocks, &non_full_blocks};
+    FarMemoryGroup* group;
+    StoreFactory factory;
 
     size_t ref_count{0};
 
+    inline HintAllocatorImpl(FarMemoryGroup& group = FarMemoryGroup::default_group, StoreFactory factory = StoreFactory::automatic()) noexcept
+        : group{&group}, factory{factory} {}
+
     inline static void dec_ref(HintAllocatorImpl* ptr) noexcept;
     inline std::unique_ptr<HintAllocatorImpl, void (*)(HintAllocatorImpl*)> shallow_copy() noexcept;
     ~HintAllocatorImpl();
@@ -160,6 +168,8 @@ struct HintAllocator {
     std::invoke_result_t<decltype(&Impl::shallow_copy), Impl*> pimpl;
 
     inline constexpr HintAllocator() : pimpl{(new Impl)->shallow_copy()} {}
+    inline explicit HintAllocator(FarMemoryGroup& group, StoreFactory factory = StoreFactory::automatic())
+        : pimpl{(new Impl{group, factory})->shallow_copy()} {}
     inline constexpr HintAllocator(const HintAllocator& other) noexcept : pimpl{other.pimpl->shallow_copy()} {}
     inline constexpr HintAllocator& operator=(const HintAllocator& other) noexcept { pimpl = other.pimpl->shallow_copy(); }
     inline constexpr HintAllocator(HintAllocator&&) noexcept = default;
@@ -184,6 +194,8 @@ struct HintAllocator {
     [[nodiscard]] inline T* allocate(size_t n);
     [[nodiscard]] inline T* allocate(size_t n, const void* hint);
     inline void deallocate(T* p, size_t n) noexcept;
+
+    inline static void prefetch(const void* ptr, size_t len) noexcept { LocalMemoryStore::prefetch(ptr, len); }
 };
 
 }  // namespace FarMalloc
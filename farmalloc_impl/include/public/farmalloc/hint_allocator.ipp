@@ -5,6 +5,7 @@
 #include <farmalloc/aligned_mmap.hpp>
 #include <farmalloc/collective_allocator_params.hpp>
 #include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/store_buffer.hpp>
 
 #include <bit>
 #include <concepts>
@@ -187,10 +188,11 @@ consteval size_t NBlocksForHintAllocArena()
 
 
 template <size_t BlockSize>
-HintAllocArena<BlockSize>::HintAllocArena()
+HintAllocArena<BlockSize>::HintAllocArena(FarMemoryGroup& group, StoreFactory factory)
 {
-    auto* const store = this->store_buf.construct(DataNPages * PageSize);
-    LocalMemoryStore::umap(reinterpret_cast<void*>(block_idx2head_ptr(0)), DataNPages * PageSize, store);
+    auto* const region = reinterpret_cast<void*>(block_idx2head_ptr(0));
+    auto* const store = this->store_buf.construct(region, DataNPages * PageSize, ArenaKind::hint, factory, BlockSize);
+    LocalMemoryStore::umap(region, DataNPages * PageSize, store, group);
 
     if (NBlocks % 64 != 0) {
         this->is_block_used.back() = ~uint64_t{0} << (NBlocks % 64);
@@ -201,10 +203,10 @@ HintAllocArena<BlockSize>::HintAllocArena()
 }
 
 template <size_t BlockSize>
-auto HintAllocArena<BlockSize>::create() -> HintAllocArena&
+auto HintAllocArena<BlockSize>::create(FarMemoryGroup& group, StoreFactory factory) -> HintAllocArena&
 {
     const auto arena_addr = AlignedMMap<ArenaSize, 0>(ArenaSize);
-    return *new (arena_addr) HintAllocArena;
+    return *new (arena_addr) HintAllocArena{group, factory};
 }
 
 template <size_t BlockSize>
@@ -328,7 +330,7 @@ void* HintAllocatorImpl<BlockSize>::allocate(size_t n_elems)
             current_arena = &first->arena();
             current_block_idx = static_cast<size_t>(current_arena->find_free_and_allocate());
         } else {
-            current_arena = &Arena::create();
+            current_arena = &Arena::create(*group, factory);
             current_block_idx = 0;
         }
     }();
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace FarMalloc
+{
+
+// how a mapping is backed:
+// `transparent` asks for THP with madvise(MADV_HUGEPAGE), which the kernel may ignore;
+// `hugetlb` takes pages from the hugetlbfs pool (MAP_HUGETLB) and falls back to `transparent` when the pool cannot serve the mapping
+enum class HugePageMode : uint8_t {
+    none,
+    transparent,
+    hugetlb,
+};
+
+inline constexpr size_t HugePageSize = size_t{1} << 21;
+// purely-local arenas start on a huge page; one mapped with huge pages also reserves the rest of it,
+// so that no arena of another kind shares the huge page
+static_assert(SubspaceInterval % HugePageSize == 0 && PurelyLocalOffset % HugePageSize == 0);
+
+// a mapping backed by huge pages spans whole huge pages, even if only its first `size` bytes are used
+inline constexpr size_t HugePageExtent(size_t size, HugePageMode mode) noexcept
+{
+    return mode == HugePageMode::none ? size : (size + HugePageSize - 1) / HugePageSize * HugePageSize;
+}
+
+}  // namespace FarMalloc
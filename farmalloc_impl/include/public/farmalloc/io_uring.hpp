@@ -0,0 +1,47 @@
+#pragma once
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+
+
+namespace FarMalloc
+{
+
+// minimal io_uring wrapper on top of the raw system calls; not thread-safe by itself
+struct IoUring {
+    int ring_fd = -1;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_sqe* sqes;
+    io_uring_cqe* cqes;
+    unsigned sq_entries, cq_entries;
+
+    unsigned local_sq_tail = 0;
+    unsigned n_unsubmitted = 0;
+
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+
+    // return false if io_uring is not available (old kernel, seccomp, ...)
+    inline bool setup(unsigned entries) noexcept;
+    inline void teardown() noexcept;
+    inline bool is_active() const noexcept { return ring_fd != -1; }
+
+    // return nullptr if the submission queue is full
+    inline io_uring_sqe* get_sqe() noexcept;
+    // return the number of submitted entries, or -1
+    inline int submit() noexcept;
+    // block until at least `min_complete` completions are available without submitting anything,
+    // so that it can be called concurrently with `submit`
+    inline int wait(unsigned min_complete) const noexcept;
+
+    // return nullptr if no completion is available
+    inline io_uring_cqe* peek_cqe() noexcept;
+    inline void cqe_seen() noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/io_uring.ipp>
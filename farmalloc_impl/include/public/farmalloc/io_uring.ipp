@@ -0,0 +1,129 @@
+#pragma once
+
+#include <farmalloc/io_uring.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>     // mmap, munmap
+#include <sys/syscall.h>  // __NR_io_uring_*
+#include <unistd.h>       // close, syscall
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+
+namespace FarMalloc
+{
+
+bool IoUring::setup(unsigned entries) noexcept
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const auto fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd == -1) {
+        return false;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    cq_ring = single_mmap ? sq_ring : mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+        close(fd);
+        return false;
+    }
+    const auto sqes_mmap = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_mmap == MAP_FAILED) {
+        if (!single_mmap) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        munmap(sq_ring, sq_ring_size);
+        close(fd);
+        return false;
+    }
+
+    const auto sq_base = static_cast<std::byte*>(sq_ring), cq_base = static_cast<std::byte*>(cq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq_base + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq_base + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq_base + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq_base + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq_base + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq_base + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq_base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq_base + params.cq_off.cqes);
+    sqes = static_cast<io_uring_sqe*>(sqes_mmap);
+    sq_entries = params.sq_entries;
+    cq_entries = params.cq_entries;
+    local_sq_tail = *sq_tail;
+    n_unsubmitted = 0;
+    ring_fd = fd;
+    return true;
+}
+void IoUring::teardown() noexcept
+{
+    if (!is_active()) {
+        return;
+    }
+    munmap(sqes, sqes_size);
+    if (cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    munmap(sq_ring, sq_ring_size);
+    close(ring_fd);
+    ring_fd = -1;
+}
+
+io_uring_sqe* IoUring::get_sqe() noexcept
+{
+    const auto head = std::atomic_ref{*sq_head}.load(std::memory_order_acquire);
+    if (local_sq_tail - head >= sq_entries) {
+        return nullptr;
+    }
+    const auto idx = local_sq_tail & *sq_mask;
+    auto* const sqe = &sqes[idx];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sq_array[idx] = idx;
+    local_sq_tail++;
+    n_unsubmitted++;
+    return sqe;
+}
+int IoUring::submit() noexcept
+{
+    std::atomic_ref{*sq_tail}.store(local_sq_tail, std::memory_order_release);
+    const auto res = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, n_unsubmitted, 0u, 0u, NULL, 0));
+    if (res > 0) {
+        n_unsubmitted -= static_cast<unsigned>(res);
+    }
+    return res;
+}
+int IoUring::wait(unsigned min_complete) const noexcept
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, 0u, min_complete, IORING_ENTER_GETEVENTS, NULL, 0));
+}
+
+io_uring_cqe* IoUring::peek_cqe() noexcept
+{
+    const auto head = *cq_head;
+    if (head == std::atomic_ref{*cq_tail}.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &cqes[head & *cq_mask];
+}
+void IoUring::cqe_seen() noexcept
+{
+    std::atomic_ref{*cq_head}.store(*cq_head + 1, std::memory_order_release);
+}
+
+}  // namespace FarMalloc
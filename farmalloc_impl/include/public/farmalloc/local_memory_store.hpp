@@ -1,49 +1,63 @@
 #pragma once
 
-#include <farmalloc/collective_allocator_params.hpp>
-
-#include <umap/store/Store.hpp>
+#include <farmalloc/arena_registry.hpp>
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/numa.hpp>
 
 #include <atomic>
 #include <cstddef>
-
-#include <bit>
-#include <unordered_map>
-#include <utility>
+#include <cstdint>
+#include <thread>
 
 
 namespace FarMalloc
 {
 
-struct LocalMemoryStore : Umap::Store {
+struct FarMemoryGroup;
+
+struct LocalMemoryStore : BackingStore {
+    // transfers of every store kind, not only this one
     static std::atomic_uint64_t read_cnt;
     static std::atomic_uint64_t write_cnt;
+    // how stores constructed afterwards map and place their copy
+    static std::atomic<HugePageMode> huge_pages;
+    static std::atomic<NumaPlacement> numa;
 
     std::byte* backing_data;
+    HugePageMode backing_huge_pages;
 
     inline LocalMemoryStore(size_t size);
-    inline void destroy(size_t size);
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
 
     inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
     inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
 
-    inline static constexpr auto arena_ptr_hash(void* ptr) {
-        return static_cast<size_t>(std::rotl(reinterpret_cast<uintptr_t>(ptr), std::bit_width(ArenaSize) - 1));
-    }
-    using MappingType = std::unordered_map<void*, std::pair<size_t, LocalMemoryStore*>, size_t(*)(void*)>;
-    static MappingType mapping;
-    static bool far_memory_mode;
+    static ArenaRegistry mapping;
 
-    inline static void umap(void* ptr, size_t size, LocalMemoryStore* store);
-    inline static bool mode_change();
+    inline static void umap(void* ptr, size_t size, BackingStore* store, FarMemoryGroup& group);
+    // switch the regions of FarMemoryGroup::default_group
+    inline static bool mode_change(unsigned n_threads = std::thread::hardware_concurrency());
     inline static void uunmap(void* ptr, size_t size);
-};
-
-
-struct LocalMemoryStoreBuffer {
-    alignas(LocalMemoryStore) std::byte buf[sizeof(LocalMemoryStore)];
-    inline LocalMemoryStore* construct(size_t size);
-    inline void destroy(size_t size);
+    // [ptr, ptr + size), whole pages of an umapped region, holds nothing live: drop its far copy if the region is far;
+    // local pages are left alone, as purging them would cost a madvise now and a zero-fill fault on reuse
+    inline static void discard(void* ptr, size_t size) noexcept;
+
+    // start fetching the pages of [ptr, ptr + len) asynchronously if they belong to an umapped region
+    // (a hint: never blocks and ignores addresses it does not know)
+    inline static void prefetch(const void* ptr, size_t len) noexcept;
+    // keep the pages of [ptr, ptr + len) longer in local memory, in the same manner: each page keeps the highest priority asked for it,
+    // UINT8_MAX pins it and 0 returns it to plain recency; best effort, as a region forgets it when it is umapped again
+    inline static void set_priority(const void* ptr, size_t len, uint8_t priority) noexcept;
+    // write the pages of [ptr, ptr + len) back and release their local memory now, in the same manner, dropping their priority
+    inline static void mark_cold(const void* ptr, size_t len);
+
+private:
+    // call `f(begin, end)` with [ptr, ptr + len) clipped to its umapped region, if the region is far, holding its group's mode lock
+    template <class F>
+    inline static void with_far_range(const void* ptr, size_t len, F&& f);
 };
 
 }  // namespace FarMalloc
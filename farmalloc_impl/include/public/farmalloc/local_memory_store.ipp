@@ -2,109 +2,185 @@
 
 #include <farmalloc/local_memory_store.hpp>
 
-#include <farmalloc/collective_allocator_params.hpp>
-
-#include <umap/umap.h>
+#include <farmalloc/aligned_mmap.hpp>
+#include <farmalloc/arena_registry.hpp>
+#include <farmalloc/far_memory_group.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/numa.hpp>
+#include <farmalloc/pager.hpp>
 
 #include <errno.h>     // errno
-#include <sys/mman.h>  // mmap, munmap
+#include <sys/mman.h>  // madvise, mmap, munmap
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
-#include <memory>
+#include <mutex>
 #include <new>
+#include <shared_mutex>
 #include <system_error>
-#include <utility>
 
 
 namespace FarMalloc
 {
 
-LocalMemoryStore::LocalMemoryStore(size_t size)
+LocalMemoryStore::LocalMemoryStore(size_t size) : backing_huge_pages{huge_pages.load(std::memory_order_relaxed)}
 {
-    const auto mmap_result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (mmap_result == MAP_FAILED) [[unlikely]] {
-        if (errno == ENOMEM) [[likely]] {
-            throw std::bad_alloc{};
+    if (backing_huge_pages != HugePageMode::none) {
+        backing_data = static_cast<std::byte*>(AlignedMMap<HugePageSize, 0>(size, backing_huge_pages));
+    } else {
+        const auto mmap_result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mmap_result == MAP_FAILED) [[unlikely]] {
+            if (errno == ENOMEM) [[likely]] {
+                throw std::bad_alloc{};
+            }
+            throw std::system_error{errno, std::generic_category(), "mmap"};
         }
-        throw std::system_error{errno, std::generic_category(), "mmap"};
+        backing_data = reinterpret_cast<std::byte*>(mmap_result);
     }
-    backing_data = reinterpret_cast<std::byte*>(mmap_result);
+    Numa::adopt(backing_data, HugePageExtent(size, backing_huge_pages), NumaTier::backing, numa.load(std::memory_order_relaxed));
 }
 void LocalMemoryStore::destroy(size_t size)
 {
-    if (munmap(backing_data, size) == -1) [[unlikely]] {
-        if (errno == ENOMEM) [[likely]] {
-            throw std::bad_alloc{};
-        }
-        throw std::system_error{errno, std::generic_category(), "munmap"};
-    }
+    Numa::forget(backing_data);
+    MUnmap(backing_data, size, backing_huge_pages);
+}
+void LocalMemoryStore::populate(const std::byte* src, size_t size)
+{
+    std::memcpy(backing_data, src, size);
+}
+void LocalMemoryStore::discard(off_t off, size_t size) noexcept
+{
+    madvise(backing_data + off, size, MADV_DONTNEED);  // failure only keeps the memory
 }
 
 ssize_t LocalMemoryStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
 {
-    read_cnt++;
+    read_cnt.fetch_add(1, std::memory_order_relaxed);
     std::memcpy(buf, backing_data + off, size_in_bytes);
     return size_in_bytes;
 }
 ssize_t LocalMemoryStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
 {
-    write_cnt++;
+    write_cnt.fetch_add(1, std::memory_order_relaxed);
     std::memcpy(backing_data + off, buf, size_in_bytes);
     return size_in_bytes;
 }
 
 
-void LocalMemoryStore::umap(void* ptr, size_t size, LocalMemoryStore* store)
+void LocalMemoryStore::umap(void* ptr, size_t size, BackingStore* store, FarMemoryGroup& group)
 {
-    mapping.insert({ptr, {size, store}});
-    if (far_memory_mode) {
-        void* const mapped = Umap::umap_ex(ptr, size, PROT_READ | PROT_WRITE, UMAP_PRIVATE | UMAP_FIXED, -1, 0, store);
-        if (mapped == UMAP_FAILED) [[unlikely]] {
-            throw std::bad_alloc{};
+    std::shared_lock lock{group.mode_mtx};
+    {
+        std::lock_guard regions_lock{group.regions_mtx};
+        group.regions.insert(reinterpret_cast<uintptr_t>(ptr));
+    }
+    try {
+        if (group.far_memory_mode) {
+            Pager::map(ptr, size, store);
         }
+        mapping.insert(ptr, size, store, &group, group.far_memory_mode);
+    } catch (...) {
+        std::lock_guard regions_lock{group.regions_mtx};
+        group.regions.erase(reinterpret_cast<uintptr_t>(ptr));
+        throw;
     }
 }
-bool LocalMemoryStore::mode_change()
+bool LocalMemoryStore::mode_change(unsigned n_threads)
 {
-    if (far_memory_mode) {
-        for (const auto& [ptr, map] : mapping) {
-            const auto& [size, store] = map;
-            ::uunmap(ptr, size);
-        }
-        far_memory_mode = false;
-    } else {
-        for (const auto& [ptr, map] : mapping) {
-            const auto& [size, store] = map;
-            std::memcpy(store->backing_data, ptr, size);
-            if (madvise(ptr, size, MADV_DONTNEED) != 0) {
-                throw std::system_error{errno, std::generic_category(), "madvise(MADV_DONTNEED)"};
-            }
-            void* const mapped = Umap::umap_ex(ptr, size, PROT_READ | PROT_WRITE, UMAP_PRIVATE | UMAP_FIXED, -1, 0, store);
-            if (mapped == UMAP_FAILED) [[unlikely]] {
-                throw std::bad_alloc{};
-            }
-        }
-        far_memory_mode = true;
-    }
-    return far_memory_mode;
+    return FarMemoryGroup::default_group.mode_change(n_threads);
 }
 void LocalMemoryStore::uunmap(void* ptr, size_t size)
 {
-    mapping.erase(ptr);
-    if (far_memory_mode) {
-        ::uunmap(ptr, size);
+    const auto entry = mapping.find(ptr);
+    if (!entry) [[unlikely]] {
+        return;
+    }
+    // the far flag only changes under the exclusive lock of the group
+    auto& group = *entry->group;
+    std::shared_lock lock{group.mode_mtx};
+    const auto locked = mapping.find(ptr);
+    if (!locked) [[unlikely]] {  // unmapped by a racing call
+        return;
+    }
+    mapping.erase(ptr, size);
+    {
+        std::lock_guard regions_lock{group.regions_mtx};
+        group.regions.erase(reinterpret_cast<uintptr_t>(ptr));
+    }
+    if (locked->far) {
+        Pager::unmap(ptr, size);
+    }
+}
+void LocalMemoryStore::discard(void* ptr, size_t size) noexcept
+{
+    if (FarMemoryGroup::n_far_groups.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    const auto entry = mapping.find(ptr);
+    if (!entry || !entry->far) {
+        return;
+    }
+    std::shared_lock lock{entry->group->mode_mtx};
+    const auto locked = mapping.find(ptr);
+    if (!locked || !locked->far) [[unlikely]] {
+        return;
+    }
+    // the pager may still hold the pages; the store is told so that it neither keeps nor returns their contents
+    locked->store->discard(static_cast<std::byte*>(ptr) - static_cast<std::byte*>(locked->ptr), size);
+}
+
+template <class F>
+void LocalMemoryStore::with_far_range(const void* ptr, size_t len, F&& f)
+{
+    if (FarMemoryGroup::n_far_groups.load(std::memory_order_relaxed) == 0) {
+        return;
     }
+    const auto entry = mapping.find(ptr);
+    if (!entry || !entry->far) {
+        return;
+    }
+    // a region being converted is skipped rather than waited for
+    std::shared_lock lock{entry->group->mode_mtx, std::try_to_lock};
+    if (!lock.owns_lock()) {
+        return;
+    }
+    if (const auto locked = mapping.find(ptr); !locked || !locked->far) {
+        return;
+    }
+
+    const auto region_begin = reinterpret_cast<uintptr_t>(entry->ptr);
+    const auto region_end = region_begin + entry->size;
+    f(std::max(reinterpret_cast<uintptr_t>(ptr), region_begin), std::min(reinterpret_cast<uintptr_t>(ptr) + len, region_end));
 }
 
+void LocalMemoryStore::prefetch(const void* ptr, size_t len) noexcept
+{
+    with_far_range(ptr, len, [](uintptr_t begin, uintptr_t end) {
+        static const auto pager_page_size = static_cast<uintptr_t>(Pager::page_size());
+        const auto page = begin / pager_page_size * pager_page_size;
+
+        // consecutive hints often hit the same page
+        thread_local uintptr_t last_page = 0;
+        if (page == last_page && end <= page + pager_page_size) {
+            return;
+        }
+        last_page = page;
 
-LocalMemoryStore* LocalMemoryStoreBuffer::construct(size_t size)
+        Pager::prefetch(page, end);
+    });
+}
+
+void LocalMemoryStore::set_priority(const void* ptr, size_t len, uint8_t priority) noexcept
 {
-    return std::construct_at(reinterpret_cast<LocalMemoryStore*>(buf), size);
+    with_far_range(ptr, len, [priority](uintptr_t begin, uintptr_t end) { Pager::set_priority(begin, end, priority); });
 }
-void LocalMemoryStoreBuffer::destroy(size_t size)
+
+void LocalMemoryStore::mark_cold(const void* ptr, size_t len)
 {
-    std::launder(reinterpret_cast<LocalMemoryStore*>(buf))->destroy(size);
+    with_far_range(ptr, len, [](uintptr_t begin, uintptr_t end) { Pager::release(begin, end); });
 }
 
 }  // namespace FarMalloc
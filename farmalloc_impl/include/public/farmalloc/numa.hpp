@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+// where the pages of a mapping go; applied with mbind(2) before the mapping is first touched
+enum class NumaPlacement : uint8_t {
+    first_touch,  // the kernel default: the node of the thread touching each page first
+    local,        // MPOL_PREFERRED: the node of the thread creating the mapping, or another one when it is full
+    bind_local,   // MPOL_BIND: only the node of the thread creating the mapping
+    interleave,   // MPOL_INTERLEAVE: page by page over every node the process may use
+};
+
+// per tier of a CollectiveAllocator; in far memory mode, only the pager decides where pages of swappable tiers go
+struct NumaPolicy {
+    NumaPlacement purely_local = NumaPlacement::first_touch;     // arenas and large allocations
+    NumaPlacement swappable_plain = NumaPlacement::first_touch;  // arenas and large allocations
+    NumaPlacement per_page = NumaPlacement::first_touch;         // arenas
+};
+
+enum class NumaTier : uint8_t {
+    purely_local,
+    swappable_plain,
+    per_page,
+    backing,  // copies kept by LocalMemoryStore and the TieredStore pool
+};
+inline constexpr size_t NNumaTiers = 4;
+
+struct NumaSnapshot {
+    // in pages of PageSize, each sampled at its first byte
+    struct Tier {
+        uint64_t n_mappings = 0;
+        uint64_t resident_pages = 0;
+        uint64_t home_pages = 0;         // on the node of the thread that created the mapping
+        uint64_t cross_node_pages = 0;   // on any other node
+        uint64_t interleaved_pages = 0;  // of interleaved mappings, which have no home node
+    };
+    std::array<Tier, NNumaTiers> by_tier{};
+    std::vector<uint64_t> pages_on_node;  // resident pages of every tier, by node
+
+    const Tier& operator[](NumaTier tier) const noexcept { return by_tier[static_cast<size_t>(tier)]; }
+};
+
+struct Numa {
+    inline static constexpr size_t MaxNodes = 1024;
+    using NodeMask = std::array<unsigned long, MaxNodes / (sizeof(unsigned long) * 8)>;
+
+    struct Mapping {
+        size_t size;
+        int home_node;  // -1 for interleaved mappings
+        NumaTier tier;
+    };
+    static bool tracking;
+    static std::mutex mappings_mtx;
+    static std::map<uintptr_t, Mapping> mappings;
+
+    // the node of the CPU the calling thread runs on
+    inline static int current_node() noexcept;
+    // apply `placement` to the whole pages [ptr, ptr + size), which must not be resident yet.
+    // a hint: a kernel without NUMA support or a single-node host leaves placement to first touch
+    inline static void place(void* ptr, size_t size, NumaPlacement placement) noexcept;
+
+    // place a mapping just created and, while tracking, keep it for snapshot(); `forget` it before unmapping
+    inline static void adopt(void* ptr, size_t size, NumaTier tier, NumaPlacement placement) noexcept;
+    inline static void forget(void* ptr) noexcept;
+
+    // mappings adopted afterwards are kept for snapshot()
+    inline static void enable_tracking() noexcept { tracking = true; }
+    inline static void disable_tracking() noexcept { tracking = false; }
+    // where the resident pages of every kept mapping are, against the node of the thread that created it
+    inline static NumaSnapshot snapshot();
+
+private:
+    inline static const NodeMask& allowed_nodes() noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/numa.ipp>
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <farmalloc/numa.hpp>
+
+#include <farmalloc/page_size.hpp>
+
+#include <linux/mempolicy.h>  // MPOL_*
+#include <sys/syscall.h>      // SYS_*
+#include <unistd.h>           // syscall
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+int Numa::current_node() noexcept
+{
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) [[unlikely]] {
+        return 0;
+    }
+    return static_cast<int>(node);
+}
+
+void Numa::place(void* ptr, size_t size, NumaPlacement placement) noexcept
+{
+    constexpr size_t BitsPerWord = sizeof(unsigned long) * 8;
+    NodeMask mask{};
+    int mode;
+    switch (placement) {
+    case NumaPlacement::local:
+    case NumaPlacement::bind_local: {
+        const auto node = static_cast<size_t>(current_node());
+        if (node >= MaxNodes) [[unlikely]] {
+            return;
+        }
+        mask[node / BitsPerWord] = 1ul << (node % BitsPerWord);
+        mode = placement == NumaPlacement::local ? MPOL_PREFERRED : MPOL_BIND;
+        break;
+    }
+    case NumaPlacement::interleave:
+        mask = allowed_nodes();
+        mode = MPOL_INTERLEAVE;
+        break;
+    case NumaPlacement::first_touch:
+    default:
+        return;
+    }
+    // the kernel reads one bit less than `maxnode`
+    syscall(SYS_mbind, ptr, size, mode, mask.data(), MaxNodes + 1, 0u);
+}
+void Numa::adopt(void* ptr, size_t size, NumaTier tier, NumaPlacement placement) noexcept
+{
+    place(ptr, size, placement);
+    if (!tracking) {
+        return;
+    }
+    const auto home_node = placement == NumaPlacement::interleave ? -1 : current_node();
+    std::lock_guard lk{mappings_mtx};
+    try {
+        mappings.insert_or_assign(reinterpret_cast<uintptr_t>(ptr), Mapping{size, home_node, tier});
+    } catch (const std::bad_alloc&) {  // only the statistics miss it
+    }
+}
+void Numa::forget(void* ptr) noexcept
+{
+    std::lock_guard lk{mappings_mtx};
+    mappings.erase(reinterpret_cast<uintptr_t>(ptr));
+}
+
+NumaSnapshot Numa::snapshot()
+{
+    NumaSnapshot res;
+    constexpr size_t Batch = 256;
+    std::array<void*, Batch> pages;
+    std::array<int, Batch> status;
+
+    std::lock_guard lk{mappings_mtx};
+    for (const auto& [addr, mapping] : mappings) {
+        auto& acc = res.by_tier[static_cast<size_t>(mapping.tier)];
+        acc.n_mappings++;
+        for (size_t off = 0; off < mapping.size;) {
+            size_t n_pages = 0;
+            for (; n_pages < Batch && off < mapping.size; n_pages++, off += PageSize) {
+                pages[n_pages] = reinterpret_cast<void*>(addr + off);
+            }
+            // with no target nodes, move_pages(2) only reports the node of each page, or a negative errno if it is not resident
+            if (syscall(SYS_move_pages, 0, n_pages, pages.data(), nullptr, status.data(), 0) != 0) [[unlikely]] {
+                continue;
+            }
+            for (size_t i = 0; i < n_pages; i++) {
+                const auto node = status[i];
+                if (node < 0) {
+                    continue;
+                }
+                acc.resident_pages++;
+                if (mapping.home_node < 0) {
+                    acc.interleaved_pages++;
+                } else if (node == mapping.home_node) {
+                    acc.home_pages++;
+                } else {
+                    acc.cross_node_pages++;
+                }
+                if (res.pages_on_node.size() <= static_cast<size_t>(node)) {
+                    res.pages_on_node.resize(static_cast<size_t>(node) + 1);
+                }
+                res.pages_on_node[static_cast<size_t>(node)]++;
+            }
+        }
+    }
+    return res;
+}
+
+auto Numa::allowed_nodes() noexcept -> const NodeMask&
+{
+    static const NodeMask mask = [] {
+        NodeMask res{};
+        if (syscall(SYS_get_mempolicy, nullptr, res.data(), MaxNodes + 1, nullptr, MPOL_F_MEMS_ALLOWED) != 0) [[unlikely]] {
+            res[0] = 1;  // node 0 alone
+        }
+        return res;
+    }();
+    return mask;
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+
+namespace FarMalloc
+{
+
+// A bit per page of a region, read and updated atomically, range by range, by the store decorators
+struct PageBitmap {
+    std::unique_ptr<std::atomic_uint64_t[]> words;
+
+    // `n_pages` bits, all set to `value`
+    inline explicit PageBitmap(size_t n_pages, bool value = false);
+
+    inline bool test(size_t page) const noexcept;
+    // whether every bit of [first_page, last_page) is set
+    inline bool all(size_t first_page, size_t last_page) const noexcept;
+    inline void assign(size_t first_page, size_t last_page, bool value) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/page_bitmap.ipp>
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <farmalloc/page_bitmap.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+namespace FarMalloc
+{
+
+PageBitmap::PageBitmap(size_t n_pages, bool value) : words{std::make_unique<std::atomic_uint64_t[]>((n_pages + 63) / 64)}
+{
+    if (value) {
+        assign(0, n_pages, true);
+    }
+}
+
+bool PageBitmap::test(size_t page) const noexcept
+{
+    return (words[page / 64].load(std::memory_order_acquire) >> (page % 64) & 1) != 0;
+}
+bool PageBitmap::all(size_t first_page, size_t last_page) const noexcept
+{
+    for (auto page = first_page; page < last_page; page++) {
+        if (!test(page)) {
+            return false;
+        }
+    }
+    return true;
+}
+void PageBitmap::assign(size_t first_page, size_t last_page, bool value) noexcept
+{
+    for (auto page = first_page; page < last_page;) {
+        // the bits of [page, end) within one word
+        const auto end = std::min(last_page, (page / 64 + 1) * 64);
+        const auto width = end - page;
+        const auto mask = (width == 64 ? ~uint64_t{0} : ((uint64_t{1} << width) - 1)) << (page % 64);
+        if (value) {
+            words[page / 64].fetch_or(mask, std::memory_order_release);
+        } else {
+            words[page / 64].fetch_and(~mask, std::memory_order_release);
+        }
+        page = end;
+    }
+}
+
+}  // namespace FarMalloc
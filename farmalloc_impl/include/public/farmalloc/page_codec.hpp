@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// LZ77 byte codec for single pages, with the sequence layout of LZ4 blocks:
+// token (literal length << 4 | (match length - MinMatch)), extended literal length, literals,
+// 2-byte little-endian offset, extended match length; the last sequence carries literals only.
+namespace FarMalloc::PageCodec
+{
+
+inline constexpr size_t MinMatch = 4;
+inline constexpr size_t MaxInputSize = size_t{1} << 16;
+inline constexpr unsigned HashBits = 12;
+
+inline uint32_t load32(const std::byte* p) noexcept
+{
+    uint32_t res;
+    std::memcpy(&res, p, sizeof(res));
+    return res;
+}
+inline constexpr uint32_t hash32(uint32_t seq) noexcept
+{
+    return (seq * 2654435761u) >> (32 - HashBits);
+}
+
+// return the compressed size, or 0 if it does not fit in `dst_capacity`
+inline size_t compress(const std::byte* src, size_t src_size, std::byte* dst, size_t dst_capacity) noexcept
+{
+    assert(src_size <= MaxInputSize);
+    std::array<uint16_t, size_t{1} << HashBits> table{};
+
+    size_t op = 0;
+    const auto emit = [&](size_t anchor, size_t lit_len, size_t offset, size_t match_len) {
+        const size_t ext_lit = lit_len >= 15 ? (lit_len - 15) / 255 + 1 : 0,
+                     ext_match = match_len != 0 && match_len - MinMatch >= 15 ? (match_len - MinMatch - 15) / 255 + 1 : 0;
+        if (op + 1 + ext_lit + lit_len + (match_len != 0 ? 2 : 0) + ext_match > dst_capacity) {
+            return false;
+        }
+        auto& token = dst[op++];
+        token = static_cast<std::byte>((lit_len >= 15 ? 15 : lit_len) << 4);
+        if (lit_len >= 15) {
+            size_t rem = lit_len - 15;
+            for (; rem >= 255; rem -= 255) {
+                dst[op++] = std::byte{255};
+            }
+            dst[op++] = static_cast<std::byte>(rem);
+        }
+        std::memcpy(dst + op, src + anchor, lit_len);
+        op += lit_len;
+        if (match_len != 0) {
+            const auto code = match_len - MinMatch;
+            token |= static_cast<std::byte>(code >= 15 ? 15 : code);
+            dst[op++] = static_cast<std::byte>(offset & 0xff);
+            dst[op++] = static_cast<std::byte>(offset >> 8);
+            if (code >= 15) {
+                size_t rem = code - 15;
+                for (; rem >= 255; rem -= 255) {
+                    dst[op++] = std::byte{255};
+                }
+                dst[op++] = static_cast<std::byte>(rem);
+            }
+        }
+        return true;
+    };
+
+    size_t ip = 0, anchor = 0;
+    while (ip + MinMatch <= src_size) {
+        const auto seq = load32(src + ip);
+        auto& slot = table[hash32(seq)];
+        const size_t ref = slot;
+        slot = static_cast<uint16_t>(ip);
+        if (ref < ip && load32(src + ref) == seq) {
+            size_t match_len = MinMatch;
+            while (ip + match_len < src_size && src[ref + match_len] == src[ip + match_len]) {
+                match_len++;
+            }
+            if (!emit(anchor, ip - anchor, ip - ref, match_len)) {
+                return 0;
+            }
+            ip += match_len;
+            anchor = ip;
+        } else {
+            ip++;
+        }
+    }
+    if (!emit(anchor, src_size - anchor, 0, 0)) {
+        return 0;
+    }
+    return op;
+}
+
+// return false if `src` is corrupted or does not decode to exactly `dst_size` bytes
+inline bool decompress(const std::byte* src, size_t src_size, std::byte* dst, size_t dst_size) noexcept
+{
+    size_t ip = 0, op = 0;
+    const auto read_ext = [&](size_t& len) {
+        for (std::byte b{255}; b == std::byte{255};) {
+            if (ip >= src_size) {
+                return false;
+            }
+            b = src[ip++];
+            len += static_cast<size_t>(b);
+        }
+        return true;
+    };
+
+    while (ip < src_size) {
+        const auto token = static_cast<unsigned>(src[ip++]);
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !read_ext(lit_len)) {
+            return false;
+        }
+        if (lit_len > src_size - ip || lit_len > dst_size - op) {
+            return false;
+        }
+        std::memcpy(dst + op, src + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == src_size) {
+            break;
+        }
+
+        if (src_size - ip < 2) {
+            return false;
+        }
+        const size_t offset = static_cast<size_t>(src[ip]) | static_cast<size_t>(src[ip + 1]) << 8;
+        ip += 2;
+        size_t match_len = token & 15;
+        if (match_len == 15 && !read_ext(match_len)) {
+            return false;
+        }
+        match_len += MinMatch;
+        if (offset == 0 || offset > op || match_len > dst_size - op) {
+            return false;
+        }
+        for (size_t i = 0; i < match_len; i++, op++) {  // may overlap
+            dst[op] = dst[op - offset];
+        }
+    }
+    return op == dst_size;
+}
+
+}  // namespace FarMalloc::PageCodec
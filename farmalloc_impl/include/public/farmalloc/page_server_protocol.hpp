@@ -0,0 +1,172 @@
+#pragma once
+
+#include <arpa/inet.h>    // inet_pton, htons
+#include <errno.h>        // errno
+#include <netinet/in.h>   // sockaddr_in, IPPROTO_TCP
+#include <netinet/tcp.h>  // TCP_NODELAY
+#include <sys/socket.h>   // socket, connect, bind, listen, send, recv
+#include <sys/un.h>       // sockaddr_un
+#include <unistd.h>       // close, unlink
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+
+
+// Wire format between RemoteStore and farmalloc_page_server.
+// Requests are pipelined on one stream connection and the server handles them in order,
+// so a read observes every write sent before it; each request is answered with a ResponseHeader carrying its tag.
+namespace FarMalloc::PageServerProtocol
+{
+
+enum class Op : uint32_t {
+    alloc,  // size -> status = new region id
+    free,   // region
+    read,   // region, offset, size -> status = size, followed by the data
+    write,  // region, offset, size, followed by the data -> status = size
+};
+
+struct RequestHeader {
+    Op op;
+    uint32_t reserved;
+    uint64_t tag;
+    uint64_t region;
+    uint64_t offset;
+    uint64_t size;
+};
+struct ResponseHeader {
+    uint64_t tag;
+    int64_t status;  // negative errno on failure
+};
+
+
+inline bool send_all(int fd, const void* buf, size_t size) noexcept
+{
+    for (size_t done = 0; done < size;) {
+        const auto res = send(fd, static_cast<const std::byte*>(buf) + done, size - done, MSG_NOSIGNAL);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        done += static_cast<size_t>(res);
+    }
+    return true;
+}
+
+// amortizes the receive system calls over many small messages
+struct BufferedReader {
+    inline static constexpr size_t Capacity = size_t{1} << 16;
+
+    int fd;
+    size_t begin = 0, end = 0;
+    std::byte buf[Capacity];
+
+    inline explicit BufferedReader(int fd) noexcept : fd{fd} {}
+
+    // return false on EOF or error
+    inline bool read_exact(void* dst, size_t size) noexcept
+    {
+        auto* out = static_cast<std::byte*>(dst);
+        while (size != 0) {
+            if (begin == end) {
+                if (size >= Capacity) {  // large payloads bypass the buffer
+                    const auto res = recv(fd, out, size, MSG_WAITALL);
+                    if (res <= 0) {
+                        if (res == -1 && errno == EINTR) {
+                            continue;
+                        }
+                        return false;
+                    }
+                    out += res;
+                    size -= static_cast<size_t>(res);
+                    continue;
+                }
+                const auto res = recv(fd, buf, Capacity, 0);
+                if (res <= 0) {
+                    if (res == -1 && errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                begin = 0;
+                end = static_cast<size_t>(res);
+            }
+            const auto n = std::min(size, end - begin);
+            std::memcpy(out, buf + begin, n);
+            out += n;
+            begin += n;
+            size -= n;
+        }
+        return true;
+    }
+};
+
+
+// `address` is either "unix:PATH" or "[HOST:]PORT" (numeric IPv4, loopback if omitted)
+inline int open_socket(const std::string& address, bool listening)
+{
+    const auto check = [](int res, const char* what) {
+        if (res == -1) [[unlikely]] {
+            throw std::system_error{errno, std::generic_category(), what};
+        }
+        return res;
+    };
+
+    int fd;
+    if (address.starts_with("unix:")) {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        const auto path = address.substr(5);
+        if (path.size() >= sizeof(addr.sun_path)) {
+            throw std::system_error{ENAMETOOLONG, std::generic_category(), "sockaddr_un"};
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        fd = check(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), "socket");
+        try {
+            if (listening) {
+                unlink(addr.sun_path);
+                check(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "bind");
+                check(listen(fd, SOMAXCONN), "listen");
+            } else {
+                check(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "connect");
+            }
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+
+    } else {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        const auto colon = address.rfind(':');
+        const auto host = colon == std::string::npos ? std::string{"127.0.0.1"} : address.substr(0, colon);
+        addr.sin_port = htons(static_cast<uint16_t>(std::strtoul(address.c_str() + (colon == std::string::npos ? 0 : colon + 1), nullptr, 10)));
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            throw std::system_error{EINVAL, std::generic_category(), "inet_pton"};
+        }
+        fd = check(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0), "socket");
+        try {
+            const int one = 1;
+            if (listening) {
+                check(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)), "setsockopt(SO_REUSEADDR)");
+                check(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "bind");
+                check(listen(fd, SOMAXCONN), "listen");
+            } else {
+                check(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), "connect");
+                check(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)), "setsockopt(TCP_NODELAY)");
+            }
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+    }
+    return fd;
+}
+
+}  // namespace FarMalloc::PageServerProtocol
@@ -1,11 +1,21 @@
 #pragma once
 
-#include <cstdint>
+#include <bit>
+#include <cstddef>
+
+
+// the swap granularity, from which the size classes, the arena layout and every store transfer are derived;
+// set by the FARMALLOC_PAGE_SIZE cache variable of the build, which defines it for every user of farmalloc_impl
+#ifndef FARMALLOC_PAGE_SIZE
+#define FARMALLOC_PAGE_SIZE 4096
+#endif
 
 
 namespace FarMalloc
 {
 
-constexpr uint_fast16_t PageSize = 4096;
+constexpr size_t PageSize = FARMALLOC_PAGE_SIZE;
+// at least the system page size; at most what PageCodec and 16-bit in-page offsets cover
+static_assert(std::has_single_bit(PageSize) && 4096 <= PageSize && PageSize <= (size_t{1} << 16));
 
 }
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace FarMalloc
+{
+
+// The paging engine behind far-memory mode, chosen at build time by FARMALLOC_PAGER:
+// the Umap submodule by default, or the in-tree UffdPager.
+struct Pager {
+    // page [ptr, ptr + size) in from `store` on access from now on; the range must hold no resident data
+    inline static void map(void* ptr, size_t size, BackingStore* store);
+    // stop paging [ptr, ptr + size); its whole contents are left in local memory
+    inline static void unmap(void* ptr, size_t size);
+    // the unit the pager moves
+    inline static size_t page_size() noexcept;
+    // make the unit a multiple of PageSize, as swapping needs; called whenever a group goes far
+    inline static void adopt_page_size() noexcept;
+    // start fetching the pager pages from `page` up to `end`, all inside one mapped range, without waiting for them
+    inline static void prefetch(uintptr_t page, uintptr_t end) noexcept;
+    // keep the pages of [begin, end), inside one mapped range, in local memory longer: UINT8_MAX pins them, 0 resets them; Umap ignores this
+    inline static void set_priority(uintptr_t begin, uintptr_t end, uint8_t priority) noexcept;
+    // write the pages of [begin, end), inside one mapped range, back and drop them from local memory now; Umap ignores this
+    inline static void release(uintptr_t begin, uintptr_t end);
+    // the resident budgets of the process add up to `bytes`: Umap, which cannot release single pages, sizes its buffer by it
+    // if it has not started yet; the in-tree pager ignores this
+    inline static void size_buffer(size_t bytes) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/pager.ipp>
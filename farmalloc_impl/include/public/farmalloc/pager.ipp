@@ -0,0 +1,106 @@
+#pragma once
+
+#include <farmalloc/pager.hpp>
+
+#include <farmalloc/page_size.hpp>
+
+#ifdef FARMALLOC_UFFD_PAGER
+#include <farmalloc/uffd_pager.hpp>
+#else
+#include <umap/umap.h>
+
+#include <stdlib.h>    // setenv
+#include <sys/mman.h>  // PROT_*
+#include <unistd.h>    // sysconf
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+
+
+namespace FarMalloc
+{
+
+#ifdef FARMALLOC_UFFD_PAGER
+
+void Pager::map(void* ptr, size_t size, BackingStore* store)
+{
+    UffdPager::map(ptr, size, store);
+}
+void Pager::unmap(void* ptr, size_t size)
+{
+    UffdPager::unmap(ptr, size);
+}
+size_t Pager::page_size() noexcept
+{
+    return PageSize;
+}
+void Pager::adopt_page_size() noexcept {}
+void Pager::prefetch(uintptr_t page, uintptr_t end) noexcept
+{
+    UffdPager::prefetch(page, end);
+}
+void Pager::set_priority(uintptr_t begin, uintptr_t end, uint8_t priority) noexcept
+{
+    UffdPager::set_priority(reinterpret_cast<void*>(begin), end - begin, priority);
+}
+void Pager::release(uintptr_t begin, uintptr_t end)
+{
+    UffdPager::release(reinterpret_cast<void*>(begin), end - begin);
+}
+void Pager::size_buffer(size_t) noexcept {}
+
+#else
+
+void Pager::map(void* ptr, size_t size, BackingStore* store)
+{
+    void* const mapped = Umap::umap_ex(ptr, size, PROT_READ | PROT_WRITE, UMAP_PRIVATE | UMAP_FIXED, -1, 0, store);
+    if (mapped == UMAP_FAILED) [[unlikely]] {
+        throw std::bad_alloc{};
+    }
+}
+void Pager::unmap(void* ptr, size_t size)
+{
+    ::uunmap(ptr, size);
+}
+size_t Pager::page_size() noexcept
+{
+    return static_cast<size_t>(umapcfg_get_umap_page_size());
+}
+void Pager::adopt_page_size() noexcept
+{
+    // Umap defaults to the system page size
+    if (page_size() % PageSize != 0) {
+        umapcfg_set_umap_page_size(static_cast<long>(PageSize));
+    }
+}
+void Pager::prefetch(uintptr_t page, uintptr_t end) noexcept
+{
+    const auto unit = page_size();
+    std::array<umap_prefetch_item, 16> items;
+    while (page < end) {
+        int n_items = 0;
+        for (; page < end && n_items < static_cast<int>(items.size()); page += unit) {
+            items[n_items++].page_base_addr = reinterpret_cast<void*>(page);
+        }
+        umap_prefetch(n_items, items.data());
+    }
+}
+// Umap evicts by recency only and offers no per-page writeback
+void Pager::set_priority(uintptr_t, uintptr_t, uint8_t) noexcept {}
+void Pager::release(uintptr_t, uintptr_t) {}
+void Pager::size_buffer(size_t bytes) noexcept
+{
+    // Umap reads its buffer size, in its own pages, from the environment when it starts; see adopt_page_size for their size
+    static const auto sys_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const auto unit = sys_page_size % PageSize == 0 ? sys_page_size : PageSize;
+    setenv("UMAP_BUFSIZE", std::to_string(std::max<size_t>(bytes / unit, 1)).c_str(), 1);
+}
+
+#endif
+
+}  // namespace FarMalloc
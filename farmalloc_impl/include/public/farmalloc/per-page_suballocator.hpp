@@ -1,8 +1,11 @@
 #pragma once
 
-#include <farmalloc/local_memory_store.hpp>
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/far_memory_group.hpp>
+#include <farmalloc/numa.hpp>
 #include <farmalloc/size_class.hpp>
+#include <farmalloc/store_buffer.hpp>
+#include <farmalloc/store_factory.hpp>
 #include <util/enough_unsigned_integer.hpp>
 
 #include <array>
@@ -10,6 +13,7 @@
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
 #include <numeric>
 
 
@@ -55,10 +59,10 @@ struct PerPageArenaMetadata {
     inline static constexpr int BitmapWidth = (NBlocks + 63) / 64;
 
     Link link;
-    BlockAllocator* const block_alloc;
+    BlockAllocator* block_alloc;  // rewritten only when a checkpoint is restored
     size_t num_of_used_blocks;
     std::array<uint64_t, (NBlocks + 63) / 64> is_block_used;
-    LocalMemoryStoreBuffer store_buf;
+    StoreBuffer store_buf;
     std::array<BlockMetadata, NBlocks> block_metadata_tab;
 
     PerPageArenaMetadata(BlockAllocator& block_alloc) : block_alloc{&block_alloc} {}
@@ -95,6 +99,9 @@ public:
     inline uintptr_t block_idx2head_ptr(size_t idx) noexcept;
 
     inline constexpr int find_free_and_allocate() noexcept;
+    // a free block neither takes memory nor gets written back or read in
+    inline void discard_block(size_t idx) noexcept { this->store_buf.discard(reinterpret_cast<void*>(block_idx2head_ptr(idx)), BlockSize); }
+    inline void reuse_block(size_t idx) noexcept { this->store_buf.reuse(reinterpret_cast<void*>(block_idx2head_ptr(idx)), BlockSize); }
     inline constexpr void free(const size_t block_idx) noexcept;
     inline constexpr bool is_empty() const noexcept;
 };
@@ -135,10 +142,16 @@ struct PerPageBlockAllocatorTemplate {
     using Link = PerPageArenaLink<BlockSize>;
     using Suballocator = PerPageSuballocatorTemplate<BlockSize>;
 
+    std::mutex mtx;  // guards the arenas' block bitmaps and lists; the inside of a block is left to the thread using it
     Arena* current_arena{};
     Link non_full_arenas{&non_full_arenas, &non_full_arenas};
+    FarMemoryGroup* group;
+    StoreFactory factory;
+    NumaPlacement numa;
 
-    inline constexpr PerPageBlockAllocatorTemplate() {}
+    inline constexpr PerPageBlockAllocatorTemplate(FarMemoryGroup& group = FarMemoryGroup::default_group, StoreFactory factory = StoreFactory::automatic(),
+                                                   NumaPlacement numa = NumaPlacement::first_touch)
+        : group{&group}, factory{factory}, numa{numa} {}
     inline ~PerPageBlockAllocatorTemplate();
 
     inline Suballocator allocate_block();
@@ -4,12 +4,16 @@
 
 #include <farmalloc/aligned_mmap.hpp>
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/far_memory_group.hpp>
 #include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/numa.hpp>
+#include <farmalloc/store_buffer.hpp>
 
 #include <bit>
 #include <concepts>
 #include <cstddef>
 #include <memory>
+#include <mutex>
 #include <new>
 #include <type_traits>
 
@@ -56,8 +60,9 @@ consteval size_t NBlocksForPerPageSuballocatorArena()
 template <size_t BlockSize>
 PerPageSuballocatorArena<BlockSize>::PerPageSuballocatorArena(Base::BlockAllocator& block_alloc) : Base{block_alloc}
 {
-    auto* const store = this->store_buf.construct(DataNPages * PageSize);
-    LocalMemoryStore::umap(reinterpret_cast<void*>(block_idx2head_ptr(0)), DataNPages * PageSize, store);
+    auto* const region = reinterpret_cast<void*>(block_idx2head_ptr(0));
+    auto* const store = this->store_buf.construct(region, DataNPages * PageSize, ArenaKind::per_page, block_alloc.factory, BlockSize);
+    LocalMemoryStore::umap(region, DataNPages * PageSize, store, *block_alloc.group);
 
     if (NBlocks % 64 != 0) {
         this->is_block_used.back() = ~uint64_t{0} << (NBlocks % 64);
@@ -71,6 +76,7 @@ template <size_t BlockSize>
 auto PerPageSuballocatorArena<BlockSize>::create(Base::BlockAllocator& block_alloc) -> PerPageSuballocatorArena&
 {
     const auto arena_addr = AlignedMMap<SubspaceInterval, PerPageOffset>(ArenaSize);
+    Numa::adopt(arena_addr, ArenaSize, NumaTier::per_page, block_alloc.numa);
     return *new (arena_addr) PerPageSuballocatorArena{block_alloc};
 }
 
@@ -253,6 +259,7 @@ PerPageBlockAllocatorTemplate<BlockSize>::~PerPageBlockAllocatorTemplate()
     if (current_arena != nullptr) {
         auto& arena = *current_arena;
         arena.~Arena();
+        Numa::forget(&arena);
         MUnmap(&arena, ArenaSize);
     }
 }
@@ -261,6 +268,7 @@ template <size_t BlockSize>
 auto PerPageBlockAllocatorTemplate<BlockSize>::allocate_block() -> Suballocator
 {
     auto res = [&]() -> Suballocator {
+        std::lock_guard lock{mtx};
         if (current_arena != nullptr) {
             if (const auto block_idx = current_arena->find_free_and_allocate(); block_idx != -1) {
                 return {*current_arena, static_cast<size_t>(block_idx)};
@@ -280,23 +288,27 @@ auto PerPageBlockAllocatorTemplate<BlockSize>::allocate_block() -> Suballocator
         return {arena, 0};
     }();
 
+    res.p_arena->reuse_block(res.block_idx);
     res.initialize();
     return res;
 }
 template <size_t BlockSize>
 void PerPageBlockAllocatorTemplate<BlockSize>::deallocate_block(Arena& arena, size_t block_idx)
 {
+    std::lock_guard lock{mtx};
     arena.free(block_idx);
-    if (&arena != current_arena) {
-        if (arena.is_empty()) {
-            if (arena.link.next != nullptr) {
-                arena.link.remove_from_list();
-            }
-            arena.~Arena();
-            MUnmap(&arena, ArenaSize);
-        } else if (arena.link.next == nullptr) {
-            non_full_arenas.insert_prev(arena.link);
+    if (&arena != current_arena && arena.is_empty()) {
+        if (arena.link.next != nullptr) {
+            arena.link.remove_from_list();
         }
+        arena.~Arena();
+        Numa::forget(&arena);
+        MUnmap(&arena, ArenaSize);
+        return;
+    }
+    arena.discard_block(block_idx);
+    if (&arena != current_arena && arena.link.next == nullptr) {
+        non_full_arenas.insert_prev(arena.link);
     }
 }
 
@@ -2,6 +2,7 @@
 
 #include <farmalloc/collective_allocator_params.hpp>
 #include <farmalloc/plain_suballoc_page_metadata.hpp>
+#include <farmalloc/plain_suballoc_thread_cache.hpp>
 #include <farmalloc/size_class.hpp>
 #include <util/ssize_t.hpp>
 
@@ -41,8 +42,14 @@ protected:
     inline constexpr PlainSuballocatorArena(FreePageLink& link) noexcept;
 
 public:
-    inline static void* allocate_memory(size_t size = ArenaSize);
-    inline static PlainSuballocatorArena& create(FreePageLink& link);
+    // an arena or a large allocation, mapped and placed as `custom` says
+    template <class Custom>
+    inline static void* allocate_memory(size_t size, const Custom& custom);
+    template <class Custom>
+    inline static void release_memory(void* ptr, size_t size, const Custom& custom);
+    // `custom` is the policy of the owning suballocator, from which derived arenas take per-instance settings
+    template <class Custom>
+    inline static PlainSuballocatorArena& create(FreePageLink& link, Custom& custom);
     PlainSuballocatorArena(const PlainSuballocatorArena&) = delete;
 
     inline static PlainSuballocatorArena& from_inside_ptr(const void* ptr) noexcept;
@@ -52,8 +59,9 @@ public:
 };
 
 
+// Small allocations go through a per-thread cache; everything else, and a cache that runs empty or full, takes `mtx`.
 template <class Arena, class Custom>
-struct PlainSuballocatorImplBase {
+struct PlainSuballocatorImplBase : PlainThreadCacheOwner {
     std::array<SlabMetadata*, SizeClass::NAllocClasses> current_slabs;
     std::array<SlabLink, SizeClass::NAllocClasses> non_full_slabs;
     std::array<FreePageLink, Arena::NPageClasses> free_pages;
@@ -72,7 +80,16 @@ struct PlainSuballocatorImplBase {
     template <size_t ElemSize, size_t Alignment>
     inline void deallocate(void* const ptr, const size_t n_elems);
 
-    inline constexpr bool is_occupancy_under(double threshold) noexcept;
+    inline bool is_occupancy_under(double threshold) noexcept;
+
+    // give the calling thread's cached slots back, e.g. before the state of the suballocator is saved
+    inline void flush_thread_cache() noexcept;
+
+private:
+    // call with `mtx` held
+    template <size_t Alignment>
+    inline void* allocate_slot(size_t class_idx);
+    inline void deallocate_slot(void* ptr, size_t class_idx) noexcept;
 };
 
 
@@ -4,13 +4,19 @@
 
 #include <farmalloc/aligned_mmap.hpp>
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/numa.hpp>
+#include <farmalloc/page_size.hpp>
+#include <farmalloc/plain_suballoc_thread_cache.hpp>
 #include <farmalloc/size_class.hpp>
 #include <util/ssize_t.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <new>
 #include <numeric>
 #include <type_traits>
@@ -44,14 +50,25 @@ constexpr PlainSuballocatorArena<Appendix, AlignOffset>::PlainSuballocatorArena(
     this->metadata_tab.back().used = true;
 }
 template <class Appendix, size_t AlignOffset>
-void* PlainSuballocatorArena<Appendix, AlignOffset>::allocate_memory(size_t size)
+template <class Custom>
+void* PlainSuballocatorArena<Appendix, AlignOffset>::allocate_memory(size_t size, const Custom& custom)
 {
-    return AlignedMMap<SubspaceInterval, AlignOffset>(size);
+    auto* const res = AlignedMMap<SubspaceInterval, AlignOffset>(size, custom.huge_pages);
+    Numa::adopt(res, HugePageExtent(size, custom.huge_pages), Custom::numa_tier, custom.numa);
+    return res;
+}
+template <class Appendix, size_t AlignOffset>
+template <class Custom>
+void PlainSuballocatorArena<Appendix, AlignOffset>::release_memory(void* ptr, size_t size, const Custom& custom)
+{
+    Numa::forget(ptr);
+    MUnmap(ptr, size, custom.huge_pages);
 }
 template <class Appendix, size_t AlignOffset>
-auto PlainSuballocatorArena<Appendix, AlignOffset>::create(FreePageLink& link) -> PlainSuballocatorArena&
+template <class Custom>
+auto PlainSuballocatorArena<Appendix, AlignOffset>::create(FreePageLink& link, Custom& custom) -> PlainSuballocatorArena&
 {
-    const auto arena_addr = allocate_memory();
+    const auto arena_addr = allocate_memory(ArenaSize, custom);
     return *new (arena_addr) PlainSuballocatorArena{link};
 }
 
@@ -80,7 +97,13 @@ uintptr_t PlainSuballocatorArena<Appendix, AlignOffset>::page_idx2head_ptr(SSize
 
 template <class Arena, class Custom>
 template <class... Args>
-constexpr PlainSuballocatorImplBase<Arena, Custom>::PlainSuballocatorImplBase(Args&&... args) : current_slabs{}, custom(std::forward<Args>(args)...)
+constexpr PlainSuballocatorImplBase<Arena, Custom>::PlainSuballocatorImplBase(Args&&... args)
+    : PlainThreadCacheOwner{[](PlainThreadCacheOwner& owner, size_t class_idx, void* const* slots, size_t n_slots) noexcept {
+          for (size_t i = 0; i < n_slots; i++) {
+              static_cast<PlainSuballocatorImplBase&>(owner).deallocate_slot(slots[i], class_idx);
+          }
+      }},
+      current_slabs{}, custom(std::forward<Args>(args)...)
 {
     for (auto& list : non_full_slabs) {
         list.prev = list.next = &list;
@@ -92,6 +115,7 @@ constexpr PlainSuballocatorImplBase<Arena, Custom>::PlainSuballocatorImplBase(Ar
 template <class Arena, class Custom>
 PlainSuballocatorImplBase<Arena, Custom>::~PlainSuballocatorImplBase()
 {
+    PlainThreadCache::detach_all(*this);
     for (size_t class_idx = 0; class_idx < current_slabs.size(); class_idx++) {
         if (const auto current = current_slabs[class_idx]; current) {
             auto& arena = Arena::from_inside_ptr(current);
@@ -147,6 +171,7 @@ auto PlainSuballocatorImplBase<Arena, Custom>::allocate_page(const size_t n_page
                 arena.metadata(idx_aligned).used = true;
                 res = {&arena, static_cast<SSizeT>(idx_aligned)};
                 custom.consume_capacity(size);
+                custom.reuse_pages(reinterpret_cast<void*>(arena.page_idx2head_ptr(idx_aligned)), size);
                 return true;
             }
         }
@@ -166,7 +191,7 @@ auto PlainSuballocatorImplBase<Arena, Custom>::allocate_page(const size_t n_page
     // custom.check_capacity(size + Arena::MetadataNPages * PageSize);
     // custom.consume_capacity(Arena::MetadataNPages * PageSize);
     // custom.occupy_space(Arena::MetadataNPages * PageSize);
-    Arena::create(free_pages.back());
+    Arena::create(free_pages.back(), custom);
     [[maybe_unused]] const auto success = try_allocate(Arena::NPageClasses - 1);
     assert(success);
     return res;
@@ -175,6 +200,8 @@ template <class Arena, class Custom>
 void PlainSuballocatorImplBase<Arena, Custom>::deallocate_page(Arena& arena, SSizeT idx, size_t n_pages) noexcept
 {
     custom.reclaim_capacity(n_pages * PageSize);
+    const auto freed_ptr = reinterpret_cast<void*>(arena.page_idx2head_ptr(idx));
+    const auto freed_size = n_pages * PageSize;
     if (auto& next = arena.metadata(idx + n_pages); !next.used) {
         next.free.link.remove_from_list();
         n_pages += next.free.n_pages;
@@ -189,12 +216,13 @@ void PlainSuballocatorImplBase<Arena, Custom>::deallocate_page(Arena& arena, SSi
         arena.~Arena();
         custom.reclaim_capacity(Arena::MetadataNPages * PageSize);
         custom.reclaim_space(Arena::MetadataNPages * PageSize);
-        MUnmap(&arena, ArenaSize);
+        Arena::release_memory(&arena, ArenaSize, custom);
     } else {
         auto &self = arena.metadata(idx), &self_tail = arena.metadata(idx + n_pages - 1);
         self.used = self_tail.used = false;
         self.free.n_pages = self_tail.free.n_pages = n_pages;
         free_pages[SizeClass::page_free_size2class_idx(n_pages * PageSize)].insert_next(self.free.link);
+        custom.discard_pages(freed_ptr, freed_size);
     }
 }
 
@@ -205,51 +233,42 @@ void* PlainSuballocatorImplBase<Arena, Custom>::allocate(const size_t n_elems)
     const auto size = ElemSize * n_elems;
     if (size <= SizeClass::MaxSmallAllocSize) {
         const auto class_idx = SizeClass::alloc_size2class_idx(size);
-        auto res = [&] {
-            do {
-                if (const auto current = current_slabs[class_idx]; current != nullptr) {
-                    if (const auto slot_idx = current->allocated.find_unset_and_set(SizeClass::alloc_class_idx2n_slots(class_idx)); slot_idx != -1) {
-                        const auto current_idx = Arena::metadata_ptr2idx(current);
-                        if constexpr (Alignment > PageSize) {
-                            static_assert(Alignment == PageSize * 2);
-                            static_assert(ElemSize == PageSize * 2);
-                            assert(n_elems == 1);
-                            static_assert(SizeClass::alloc_class_idx2n_slots(SizeClass::alloc_size2class_idx(ElemSize)) == 1);
-                            if ((current_idx + Arena::MetadataNPages) % 2 != 0) {
-                                deallocate_page(Arena::from_inside_ptr(current), current_idx, 2);
+        // a slot of a class fits any alignment up to a page that its size does, so the cache is shared by them
+        if constexpr (Alignment <= PageSize) {
+            if (auto* const cache = PlainThreadCache::of(*this); cache != nullptr) [[likely]] {
+                auto& bin = cache->bins[class_idx];
+                if (bin.n_slots == 0) [[unlikely]] {
+                    std::lock_guard lock{mtx};
+                    const auto batch_size = PlainThreadCache::batch_size(class_idx);
+                    for (bool flushed = false;;) {
+                        try {
+                            while (bin.n_slots < batch_size) {
+                                bin.slots[bin.n_slots++] = allocate_slot<Alignment>(class_idx);
+                            }
+                            break;
+                        } catch (std::bad_alloc&) {
+                            if (bin.n_slots != 0) {
                                 break;
+                            } else if (flushed) {
+                                throw;
                             }
+                            // the slots this thread holds in other classes may free the pages needed
+                            cache->flush();
+                            flushed = true;
                         }
-                        auto& arena = Arena::from_inside_ptr(current);
-                        return reinterpret_cast<void*>(arena.page_idx2head_ptr(current_idx)
-                                                       + SizeClass::alloc_class_idx2size(class_idx) * slot_idx);
                     }
-                    current->link.next = nullptr;
+                    // hand them out in address order
+                    std::reverse(bin.slots.begin(), bin.slots.begin() + bin.n_slots);
                 }
-                if (const auto non_full_list = &non_full_slabs[class_idx], first = non_full_list->next; first != non_full_list) {
-                    non_full_list->next = first->next;
-                    non_full_list->next->prev = non_full_list;
-                    auto& slab = first->slab();
-                    current_slabs[class_idx] = &slab;
-                    const auto slot_idx = slab.allocated.find_unset_and_set(SizeClass::alloc_class_idx2n_slots(class_idx));
-                    auto& arena = Arena::from_inside_ptr(first);
-                    return reinterpret_cast<void*>(arena.page_idx2head_ptr(Arena::metadata_ptr2idx(first))
-                                                   + SizeClass::alloc_class_idx2size(class_idx) * slot_idx);
-                }
-            } while (false);
-            const auto n_pages = SizeClass::alloc_class_idx2n_pages(class_idx);
-            auto [p_arena, page_idx] = allocate_page<Alignment>(n_pages);
-            auto* const p_slab = std::construct_at(&p_arena->metadata(page_idx).slab, 0);
-            current_slabs[class_idx] = p_slab;
-            for (unsigned idx = 0; idx < n_pages; idx++) {
-                p_arena->metadata(page_idx + idx).slab.idx_in_slab = idx;
+                return bin.slots[--bin.n_slots];
             }
-            return reinterpret_cast<void*>(p_arena->page_idx2head_ptr(page_idx));
-        }();
-        custom.occupy_space(SizeClass::alloc_class_idx2size(class_idx));
-        return res;
+        }
+        std::lock_guard lock{mtx};
+        return allocate_slot<Alignment>(class_idx);
+    }
 
-    } else if (size <= Arena::MaxMediumAllocSize) {
+    std::lock_guard lock{mtx};
+    if (size <= Arena::MaxMediumAllocSize) {
         const size_t n_pages = (size + PageSize - 1) / PageSize;
         auto [p_arena, page_idx] = allocate_page<Alignment>(n_pages);
         custom.occupy_space(n_pages * PageSize);
@@ -264,8 +283,13 @@ void* PlainSuballocatorImplBase<Arena, Custom>::allocate(const size_t n_elems)
         custom.check_capacity(page_aligned_size);
         custom.consume_capacity(page_aligned_size);
         custom.occupy_space(page_aligned_size);
-        const auto res = Arena::allocate_memory(page_aligned_size);
-        custom.postprocess_large_alloc(res, aug_size);
+        const auto res = Arena::allocate_memory(page_aligned_size, custom);
+        try {
+            custom.postprocess_large_alloc(res, aug_size);
+        } catch (...) {
+            Arena::release_memory(res, page_aligned_size, custom);
+            throw;
+        }
         return res;
     }
 }
@@ -275,26 +299,25 @@ void PlainSuballocatorImplBase<Arena, Custom>::deallocate(void* const ptr, const
 {
     const auto size = ElemSize * n_elems;
     if (size <= SizeClass::MaxSmallAllocSize) {
-        auto& arena = Arena::from_inside_ptr(ptr);
-        auto page_idx = Arena::data_ptr2idx(ptr);
-        page_idx -= arena.metadata(page_idx).slab.idx_in_slab;
         const auto class_idx = SizeClass::alloc_size2class_idx(size);
-        const auto slot_idx = (reinterpret_cast<uintptr_t>(ptr) - arena.page_idx2head_ptr(page_idx)) / SizeClass::alloc_class_idx2size(class_idx);
-        auto& slab = arena.metadata(page_idx).slab;
-        slab.allocated.flip(slot_idx);
-        custom.reclaim_space(SizeClass::alloc_class_idx2size(class_idx));
-        if (&slab != current_slabs[class_idx]) {
-            if (slab.allocated.is_empty()) {
-                if (slab.link.next != nullptr) {
-                    slab.link.remove_from_list();
+        if constexpr (Alignment <= PageSize) {
+            if (auto* const cache = PlainThreadCache::of(*this); cache != nullptr) [[likely]] {
+                auto& bin = cache->bins[class_idx];
+                if (bin.n_slots == 2 * PlainThreadCache::batch_size(class_idx)) [[unlikely]] {
+                    std::lock_guard lock{mtx};
+                    cache->flush_batch(class_idx);
                 }
-                deallocate_page(arena, page_idx, SizeClass::alloc_class_idx2n_pages(class_idx));
-            } else if (slab.link.next == nullptr) {
-                non_full_slabs[class_idx].insert_prev(slab.link);
+                bin.slots[bin.n_slots++] = ptr;
+                return;
             }
         }
+        std::lock_guard lock{mtx};
+        deallocate_slot(ptr, class_idx);
+        return;
+    }
 
-    } else if (size <= Arena::MaxMediumAllocSize) {
+    std::lock_guard lock{mtx};
+    if (size <= Arena::MaxMediumAllocSize) {
         auto& arena = Arena::from_inside_ptr(ptr);
         auto page_idx = Arena::data_ptr2idx(ptr);
         const size_t n_pages = (size + PageSize - 1) / PageSize;
@@ -307,16 +330,95 @@ void PlainSuballocatorImplBase<Arena, Custom>::deallocate(void* const ptr, const
         const auto page_aligned_size = (aug_size + PageSize - 1) / PageSize * PageSize;
         custom.reclaim_capacity(page_aligned_size);
         custom.reclaim_space(page_aligned_size);
-        MUnmap(ptr, page_aligned_size);
+        Arena::release_memory(ptr, page_aligned_size, custom);
     }
 }
 
 template <class Arena, class Custom>
-constexpr bool PlainSuballocatorImplBase<Arena, Custom>::is_occupancy_under(double threshold) noexcept
+template <size_t Alignment>
+void* PlainSuballocatorImplBase<Arena, Custom>::allocate_slot(const size_t class_idx)
 {
+    auto res = [&] {
+        do {
+            if (const auto current = current_slabs[class_idx]; current != nullptr) {
+                if (const auto slot_idx = current->allocated.find_unset_and_set(SizeClass::alloc_class_idx2n_slots(class_idx)); slot_idx != -1) {
+                    const auto current_idx = Arena::metadata_ptr2idx(current);
+                    if constexpr (Alignment > PageSize) {
+                        static_assert(Alignment == PageSize * 2);
+                        static_assert(SizeClass::alloc_class_idx2n_slots(SizeClass::alloc_size2class_idx(PageSize * 2)) == 1);
+                        assert(SizeClass::alloc_class_idx2size(class_idx) == PageSize * 2);
+                        if ((current_idx + Arena::MetadataNPages) % 2 != 0) {
+                            deallocate_page(Arena::from_inside_ptr(current), current_idx, 2);
+                            break;
+                        }
+                    }
+                    auto& arena = Arena::from_inside_ptr(current);
+                    return reinterpret_cast<void*>(arena.page_idx2head_ptr(current_idx)
+                                                   + SizeClass::alloc_class_idx2size(class_idx) * slot_idx);
+                }
+                current->link.next = nullptr;
+            }
+            if (const auto non_full_list = &non_full_slabs[class_idx], first = non_full_list->next; first != non_full_list) {
+                non_full_list->next = first->next;
+                non_full_list->next->prev = non_full_list;
+                auto& slab = first->slab();
+                current_slabs[class_idx] = &slab;
+                const auto slot_idx = slab.allocated.find_unset_and_set(SizeClass::alloc_class_idx2n_slots(class_idx));
+                auto& arena = Arena::from_inside_ptr(first);
+                return reinterpret_cast<void*>(arena.page_idx2head_ptr(Arena::metadata_ptr2idx(first))
+                                               + SizeClass::alloc_class_idx2size(class_idx) * slot_idx);
+            }
+        } while (false);
+        const auto n_pages = SizeClass::alloc_class_idx2n_pages(class_idx);
+        auto [p_arena, page_idx] = allocate_page<Alignment>(n_pages);
+        auto* const p_slab = std::construct_at(&p_arena->metadata(page_idx).slab, 0);
+        current_slabs[class_idx] = p_slab;
+        for (unsigned idx = 0; idx < n_pages; idx++) {
+            p_arena->metadata(page_idx + idx).slab.idx_in_slab = idx;
+        }
+        return reinterpret_cast<void*>(p_arena->page_idx2head_ptr(page_idx));
+    }();
+    custom.occupy_space(SizeClass::alloc_class_idx2size(class_idx));
+    return res;
+}
+template <class Arena, class Custom>
+void PlainSuballocatorImplBase<Arena, Custom>::deallocate_slot(void* const ptr, const size_t class_idx) noexcept
+{
+    auto& arena = Arena::from_inside_ptr(ptr);
+    auto page_idx = Arena::data_ptr2idx(ptr);
+    page_idx -= arena.metadata(page_idx).slab.idx_in_slab;
+    const auto slot_idx = (reinterpret_cast<uintptr_t>(ptr) - arena.page_idx2head_ptr(page_idx)) / SizeClass::alloc_class_idx2size(class_idx);
+    auto& slab = arena.metadata(page_idx).slab;
+    slab.allocated.flip(slot_idx);
+    custom.reclaim_space(SizeClass::alloc_class_idx2size(class_idx));
+    if (&slab != current_slabs[class_idx]) {
+        if (slab.allocated.is_empty()) {
+            if (slab.link.next != nullptr) {
+                slab.link.remove_from_list();
+            }
+            deallocate_page(arena, page_idx, SizeClass::alloc_class_idx2n_pages(class_idx));
+        } else if (slab.link.next == nullptr) {
+            non_full_slabs[class_idx].insert_prev(slab.link);
+        }
+    }
+}
+
+template <class Arena, class Custom>
+bool PlainSuballocatorImplBase<Arena, Custom>::is_occupancy_under(double threshold) noexcept
+{
+    std::lock_guard lock{mtx};
     return custom.is_occupancy_under(threshold);
 }
 
+template <class Arena, class Custom>
+void PlainSuballocatorImplBase<Arena, Custom>::flush_thread_cache() noexcept
+{
+    if (auto* const cache = PlainThreadCache::of(*this); cache != nullptr) {
+        std::lock_guard lock{mtx};
+        cache->flush();
+    }
+}
+
 
 template <class Impl>
 template <size_t ElemSize, size_t Alignment>
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <farmalloc/size_class.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+struct PlainThreadCache;
+
+// the part of a plain suballocator that its thread caches see
+struct PlainThreadCacheOwner {
+    // guards the slabs, free pages and capacity of the suballocator
+    std::mutex mtx;
+    // take cached slots of a class back; called with `mtx` held
+    void (*give_back)(PlainThreadCacheOwner& owner, size_t class_idx, void* const* slots, size_t n_slots) noexcept;
+    // the caches in front of this owner, linked through PlainThreadCache::next; guarded by PlainThreadCache::registry_mtx
+    PlainThreadCache* caches = nullptr;
+
+    inline explicit PlainThreadCacheOwner(decltype(give_back) give_back) noexcept : give_back{give_back} {}
+};
+
+// A thread's cache of free small slots in front of one plain suballocator, in the manner of jemalloc's tcache:
+// small allocations and deallocations take no lock until their bin runs empty or full,
+// and then move a batch of slots at once under the suballocator's lock.
+// Batches are cut to about BatchBytes, so that a thread holds little of the capacity in the larger classes.
+// Cached slots count as occupied for the suballocator; they go back when the thread exits or the suballocator is destroyed.
+struct PlainThreadCache {
+    inline static constexpr size_t BinCapacity = 32, BatchSize = BinCapacity / 2;
+    inline static constexpr size_t BatchBytes = 8 * 1024;
+
+    // slots moved at once for a class; its bin holds twice as many
+    inline static constexpr size_t batch_size(size_t class_idx) noexcept
+    {
+        return std::clamp(BatchBytes / SizeClass::alloc_class_idx2size(class_idx), size_t{1}, BatchSize);
+    }
+
+    struct Bin {
+        uint32_t n_slots = 0;
+        std::array<void*, BinCapacity> slots;  // the last one is handed out first
+    };
+    // the caches of a thread, flushed to their owners when it exits
+    struct Local {
+        std::vector<std::unique_ptr<PlainThreadCache>> caches;
+        PlainThreadCache* last = nullptr;
+
+        inline ~Local();
+    };
+
+    static std::mutex registry_mtx;  // taken before any owner's `mtx`
+    static thread_local Local local;
+    // set once `local` is destroyed, for the thread-local and static objects that free memory after it
+    static thread_local bool local_gone;
+
+    std::atomic<PlainThreadCacheOwner*> owner;  // nullptr once detached, after which the cache may serve another owner
+    PlainThreadCache* next = nullptr;
+    std::array<Bin, SizeClass::NAllocClasses> bins{};
+
+    // the calling thread's cache in front of `owner`, created on first use; nullptr if it cannot be created or the thread is exiting
+    inline static PlainThreadCache* of(PlainThreadCacheOwner& owner) noexcept;
+    // hand the slots of every cache in front of `owner` back and forget the caches; for the owner's destructor
+    inline static void detach_all(PlainThreadCacheOwner& owner) noexcept;
+
+    // hand the oldest batch of a full bin back; call with the owner's `mtx` held
+    inline void flush_batch(size_t class_idx) noexcept;
+    // hand every slot back; call with the owner's `mtx` held
+    inline void flush() noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/plain_suballoc_thread_cache.ipp>
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <farmalloc/plain_suballoc_thread_cache.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+PlainThreadCache::Local::~Local()
+{
+    local_gone = true;
+    std::lock_guard registry{registry_mtx};
+    for (auto& cache : caches) {
+        auto* const owner = cache->owner.load(std::memory_order_relaxed);
+        if (owner == nullptr) {
+            continue;
+        }
+        {
+            std::lock_guard lock{owner->mtx};
+            cache->flush();
+        }
+        auto** link = &owner->caches;
+        while (*link != cache.get()) {
+            link = &(*link)->next;
+        }
+        *link = cache->next;
+    }
+}
+
+PlainThreadCache* PlainThreadCache::of(PlainThreadCacheOwner& owner) noexcept
+{
+    if (local_gone) [[unlikely]] {
+        return nullptr;
+    }
+    auto& self = local;
+    if (self.last != nullptr && self.last->owner.load(std::memory_order_relaxed) == &owner) [[likely]] {
+        return self.last;
+    }
+    for (auto& cache : self.caches) {
+        if (cache->owner.load(std::memory_order_relaxed) == &owner) {
+            return self.last = cache.get();
+        }
+    }
+
+    std::lock_guard registry{registry_mtx};
+    // the cache of an owner that is gone holds nothing worth keeping
+    auto it = std::ranges::find_if(self.caches, [](auto& cache) { return cache->owner.load(std::memory_order_relaxed) == nullptr; });
+    PlainThreadCache* cache;
+    if (it != self.caches.end()) {
+        cache = it->get();
+        for (auto& bin : cache->bins) {
+            bin.n_slots = 0;
+        }
+    } else {
+        try {
+            cache = self.caches.emplace_back(std::make_unique<PlainThreadCache>()).get();
+        } catch (...) {
+            return nullptr;
+        }
+    }
+    cache->owner.store(&owner, std::memory_order_relaxed);
+    cache->next = owner.caches;
+    owner.caches = cache;
+    return self.last = cache;
+}
+void PlainThreadCache::detach_all(PlainThreadCacheOwner& owner) noexcept
+{
+    std::lock_guard registry{registry_mtx};
+    std::lock_guard lock{owner.mtx};
+    for (auto* cache = owner.caches; cache != nullptr; cache = cache->next) {
+        // no thread uses an owner being destroyed, so its bins are ours to empty
+        cache->flush();
+        cache->owner.store(nullptr, std::memory_order_relaxed);
+    }
+    owner.caches = nullptr;
+}
+
+void PlainThreadCache::flush_batch(size_t class_idx) noexcept
+{
+    auto& bin = bins[class_idx];
+    auto* const owner = this->owner.load(std::memory_order_relaxed);
+    const auto n_slots = batch_size(class_idx);
+    owner->give_back(*owner, class_idx, bin.slots.data(), n_slots);
+    std::copy(bin.slots.begin() + static_cast<ptrdiff_t>(n_slots), bin.slots.begin() + bin.n_slots, bin.slots.begin());
+    bin.n_slots -= static_cast<uint32_t>(n_slots);
+}
+void PlainThreadCache::flush() noexcept
+{
+    auto* const owner = this->owner.load(std::memory_order_relaxed);
+    for (size_t class_idx = 0; class_idx < bins.size(); class_idx++) {
+        auto& bin = bins[class_idx];
+        owner->give_back(*owner, class_idx, bin.slots.data(), bin.n_slots);
+        bin.n_slots = 0;
+    }
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+struct PrefetchConfig {
+    size_t min_window = 2;   // in strides
+    size_t max_window = 64;  // in strides
+};
+
+// Decorator that watches the offsets of the reads (i.e. the page faults) of one region and has umap fetch ahead:
+// - a fault inside a block of a block-structured arena fetches the rest of the block;
+// - three faults with a common stride (sequential, strided, ascending or descending) start a stream,
+//   whose next `window` strides are prefetched; the fault right after the window confirms the stream and doubles it,
+//   and a fault off the stream halves it, so one synchronous fault per window remains on a stable scan.
+// Reads of pages it asked for are the prefetches arriving and are not taken as faults.
+struct PrefetchingStore : BackingStore {
+    static bool enabled;
+    static PrefetchConfig config;
+
+    static std::atomic_uint64_t n_prefetched_pages;
+    static std::atomic_uint64_t n_confirmed;
+    static std::atomic_uint64_t n_broken;
+
+    BackingStore* inner;
+    std::byte* region;
+    size_t region_size;
+    size_t block_size;  // PageSize unless the arena is carved into larger blocks
+
+    std::mutex mtx;
+    std::array<off_t, 2> history{-1, -1};  // offsets of the last two faults off any stream, the newest first
+    off_t stride = 0;                      // 0 while no stream is running
+    size_t window = 0;
+    off_t expected = 0;                       // the fault that confirms the stream
+    off_t issued_first = 0, issued_last = 0;  // the pages requested for the stream, every `stride` bytes
+    off_t issued_block = -1;                  // the block whose other pages were requested last
+
+    inline PrefetchingStore(BackingStore* inner, void* region, size_t region_size, size_t block_size) noexcept
+        : inner{inner}, region{static_cast<std::byte*>(region)}, region_size{region_size}, block_size{block_size} {}
+    inline void destroy(size_t size) override { inner->destroy(size); }
+    inline void populate(const std::byte* src, size_t size) override { inner->populate(src, size); }
+    inline void discard(off_t off, size_t size) noexcept override { inner->discard(off, size); }
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override { return inner->write_to_store(buf, size_in_bytes, off); }
+
+    // every swappable arena created afterwards has its store wrapped
+    inline static void enable(const PrefetchConfig& cfg = {}) noexcept;
+    inline static void disable() noexcept { enabled = false; }
+    inline static bool is_enabled() noexcept { return enabled; }
+
+private:
+    inline bool is_issued(off_t off) const noexcept;
+    inline void observe(off_t off) noexcept;
+    inline void issue_window(off_t from) noexcept;
+    inline void prefetch(off_t off, size_t len) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/prefetching_store.ipp>
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <farmalloc/prefetching_store.hpp>
+
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+void PrefetchingStore::enable(const PrefetchConfig& cfg) noexcept
+{
+    config = cfg;
+    config.min_window = std::max<size_t>(config.min_window, 1);
+    config.max_window = std::max(config.max_window, config.min_window);
+    enabled = true;
+}
+
+ssize_t PrefetchingStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    observe(off);
+    return inner->read_from_store(buf, size_in_bytes, off);
+}
+
+
+bool PrefetchingStore::is_issued(off_t off) const noexcept
+{
+    if (stride == 0) {
+        return false;
+    }
+    const auto lo = std::min(issued_first, issued_last), hi = std::max(issued_first, issued_last);
+    return lo <= off && off <= hi && (off - issued_first) % stride == 0;
+}
+
+void PrefetchingStore::observe(off_t off) noexcept
+{
+    std::lock_guard lock{mtx};
+    const auto block_begin = off / static_cast<off_t>(block_size) * static_cast<off_t>(block_size);
+    if (is_issued(off) || block_begin == issued_block) {
+        return;
+    }
+
+    if (block_size > PageSize) {
+        const auto block_end = std::min(block_begin + static_cast<off_t>(block_size), static_cast<off_t>(region_size));
+        if (off > block_begin) {
+            prefetch(block_begin, static_cast<size_t>(off - block_begin));
+        }
+        if (off + static_cast<off_t>(PageSize) < block_end) {
+            prefetch(off + static_cast<off_t>(PageSize), static_cast<size_t>(block_end - off) - PageSize);
+        }
+        issued_block = block_begin;
+    }
+
+    if (stride != 0) {
+        if (off == expected) {
+            n_confirmed.fetch_add(1, std::memory_order_relaxed);
+            window = std::min(window * 2, config.max_window);
+            issue_window(off);
+            return;
+        }
+        n_broken.fetch_add(1, std::memory_order_relaxed);
+        window = std::max(window / 2, config.min_window);
+        stride = 0;
+    }
+
+    const auto delta = history[0] == -1 ? 0 : off - history[0];
+    if (delta != 0 && history[1] != -1 && history[0] - history[1] == delta) {
+        stride = delta;
+        window = std::max(window, config.min_window);
+        issued_first = off + stride;
+        issue_window(off);
+        history = {-1, -1};
+        return;
+    }
+    history = {off, history[0]};
+}
+
+void PrefetchingStore::issue_window(off_t from) noexcept
+{
+    const auto limit = static_cast<off_t>(region_size) - static_cast<off_t>(PageSize);
+    size_t n_pages = 0;
+    for (size_t k = 1; k <= window; k++) {
+        const auto target = from + static_cast<off_t>(k) * stride;
+        if (target < 0 || target > limit) {
+            break;
+        }
+        n_pages = k;
+    }
+    if (n_pages == 0) {
+        stride = 0;
+        return;
+    }
+    issued_last = from + static_cast<off_t>(n_pages) * stride;
+    expected = issued_last + stride;
+    if (stride == static_cast<off_t>(PageSize)) {
+        prefetch(from + stride, n_pages * PageSize);
+    } else if (stride == -static_cast<off_t>(PageSize)) {
+        prefetch(issued_last, n_pages * PageSize);
+    } else {
+        for (size_t k = 1; k <= n_pages; k++) {
+            prefetch(from + static_cast<off_t>(k) * stride, PageSize);
+        }
+    }
+}
+
+void PrefetchingStore::prefetch(off_t off, size_t len) noexcept
+{
+    n_prefetched_pages.fetch_add((len + PageSize - 1) / PageSize, std::memory_order_relaxed);
+    LocalMemoryStore::prefetch(region + off, len);
+}
+
+}  // namespace FarMalloc
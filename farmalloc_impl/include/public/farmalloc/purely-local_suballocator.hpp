@@ -3,6 +3,8 @@
 #include <farmalloc/plain_suballoc.hpp>
 
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/numa.hpp>
 
 #include <cstddef>
 
@@ -16,8 +18,13 @@ struct PurelyLocalCustom {
     size_t occupied = 0;
     size_t capacity;
     const size_t orig_capacity;
+    // arenas and large allocations; each arena then takes a whole huge page, twice its size
+    const HugePageMode huge_pages;
+    const NumaPlacement numa;
+    inline static constexpr NumaTier numa_tier = NumaTier::purely_local;
 
-    inline constexpr PurelyLocalCustom(size_t capacity) noexcept : capacity{capacity}, orig_capacity{capacity} {}
+    inline constexpr PurelyLocalCustom(size_t capacity, HugePageMode huge_pages = HugePageMode::none, NumaPlacement numa = NumaPlacement::first_touch) noexcept
+        : capacity{capacity}, orig_capacity{capacity}, huge_pages{huge_pages}, numa{numa} {}
     inline void check_capacity(size_t size);
     inline constexpr void consume_capacity(size_t size) noexcept;
     inline constexpr void reclaim_capacity(size_t size) noexcept;
@@ -28,6 +35,8 @@ struct PurelyLocalCustom {
     inline constexpr size_t large_alloc_size(size_t size) noexcept { return size; }
     inline constexpr void postprocess_large_alloc(void*, size_t) noexcept {}
     inline constexpr void preprocess_large_dealloc(void*, size_t) noexcept {}
+    inline constexpr void discard_pages(void*, size_t) noexcept {}
+    inline constexpr void reuse_pages(void*, size_t) noexcept {}
 };
 using PurelyLocalSuballocatorImpl = PlainSuballocatorImplBase<PlainSuballocatorArena<PurelyLocalArenaAppendix, PurelyLocalOffset>, PurelyLocalCustom>;
 
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/page_server_protocol.hpp>
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+// Keeps the far copy of each region in a farmalloc_page_server process reached through one shared connection.
+// Requests from all the pager threads are pipelined. Frees are buffered and sent in batches, and every other request
+// flushes the batch in front of it. Writes wait for their acknowledgement, so that a failed writeback reaches the pager,
+// which then keeps the page; WritebackStore gathers them into fewer round trips.
+struct RemoteStore : BackingStore {
+    struct Pending {
+        char* buf;
+        size_t size;
+        int64_t status = 0;
+        bool done = false;
+        std::condition_variable cv{};
+    };
+
+    static int sock_fd;
+    static std::mutex send_mtx;
+    static std::vector<std::byte> send_buf;
+    static size_t batch_bytes;
+    static uint64_t next_tag;
+
+    static std::mutex pending_mtx;
+    static std::unordered_map<uint64_t, Pending*> pending;
+    static std::thread receiver;
+
+    uint64_t region;
+
+    inline RemoteStore(size_t size);
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    // one request for the whole run
+    inline ssize_t write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept override;
+
+    // `address` is "unix:PATH" or "[HOST:]PORT"; every swappable arena created afterwards is backed by the server
+    inline static void connect(const char* address, size_t batch = size_t{1} << 18);
+    inline static void disconnect();
+    inline static bool is_connected() noexcept { return sock_fd != -1; }
+    // send the buffered frees now
+    inline static bool flush() noexcept;
+
+private:
+    // send a request and wait for its response; the status, or a negative errno
+    inline static int64_t call(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size,
+        const void* payload, char* reply_buf) noexcept;
+    // ... with the payload gathered from `iov`
+    inline static int64_t call(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size,
+        const iovec* iov, int iovcnt, char* reply_buf) noexcept;
+    // append a request to the batch without waiting for it
+    inline static bool post(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size, const void* payload) noexcept;
+    // ... with the payload gathered from `iov`
+    inline static bool post(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size, const iovec* iov, int iovcnt) noexcept;
+    // append a request to the batch, or send it directly behind the batch if its payload is large
+    inline static bool send_locked(PageServerProtocol::Op op, uint64_t tag, uint64_t region, uint64_t offset, uint64_t size,
+        const iovec* iov, int iovcnt) noexcept;
+    inline static bool flush_locked() noexcept;
+    inline static void receive_loop() noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/remote_store.ipp>
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <farmalloc/remote_store.hpp>
+
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_server_protocol.hpp>
+
+#include <errno.h>       // errno, E*
+#include <sys/socket.h>  // shutdown
+#include <sys/uio.h>     // iovec
+#include <unistd.h>      // close
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+
+namespace FarMalloc
+{
+
+RemoteStore::RemoteStore(size_t size)
+{
+    const auto status = call(PageServerProtocol::Op::alloc, 0, 0, size, nullptr, nullptr);
+    if (status < 0) [[unlikely]] {
+        if (status == -ENOMEM) [[likely]] {
+            throw std::bad_alloc{};
+        }
+        throw std::system_error{static_cast<int>(-status), std::generic_category(), "page server alloc"};
+    }
+    region = static_cast<uint64_t>(status);
+}
+void RemoteStore::destroy(size_t size)
+{
+    post(PageServerProtocol::Op::free, region, 0, size, nullptr);
+}
+void RemoteStore::populate(const std::byte* src, size_t size)
+{
+    if (const auto status = call(PageServerProtocol::Op::write, region, 0, size, src, nullptr); status < 0) [[unlikely]] {
+        throw std::system_error{static_cast<int>(-status), std::generic_category(), "page server write"};
+    }
+}
+
+ssize_t RemoteStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    LocalMemoryStore::read_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto status = call(PageServerProtocol::Op::read, region, static_cast<uint64_t>(off), size_in_bytes, nullptr, buf);
+    return status < 0 ? -1 : static_cast<ssize_t>(status);
+}
+ssize_t RemoteStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto status = call(PageServerProtocol::Op::write, region, static_cast<uint64_t>(off), size_in_bytes, buf, nullptr);
+    return status < 0 ? -1 : static_cast<ssize_t>(size_in_bytes);
+}
+ssize_t RemoteStore::write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept
+{
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    size_t size = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        size += iov[i].iov_len;
+    }
+    const auto status = call(PageServerProtocol::Op::write, region, static_cast<uint64_t>(off), size, iov, iovcnt, nullptr);
+    return status < 0 ? -1 : static_cast<ssize_t>(size);
+}
+
+
+void RemoteStore::connect(const char* address, size_t batch)
+{
+    if (is_connected()) {
+        throw std::logic_error{"RemoteStore is already connected"};
+    }
+    sock_fd = PageServerProtocol::open_socket(address, false);
+    batch_bytes = batch;
+    send_buf.clear();
+    send_buf.reserve(batch);
+    receiver = std::thread{receive_loop};
+}
+void RemoteStore::disconnect()
+{
+    if (!is_connected()) {
+        return;
+    }
+    flush();
+    shutdown(sock_fd, SHUT_RDWR);
+    receiver.join();
+    close(sock_fd);
+    sock_fd = -1;
+}
+bool RemoteStore::flush() noexcept
+{
+    std::lock_guard lk{send_mtx};
+    return flush_locked();
+}
+
+int64_t RemoteStore::call(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size, const void* payload, char* reply_buf) noexcept
+{
+    const iovec iov{const_cast<void*>(payload), payload != nullptr ? size : 0};
+    return call(op, region, offset, size, &iov, 1, reply_buf);
+}
+int64_t RemoteStore::call(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size, const iovec* iov, int iovcnt, char* reply_buf) noexcept
+{
+    Pending p{.buf = reply_buf, .size = size};
+    {
+        std::lock_guard lk{send_mtx};
+        const auto tag = next_tag++;
+        try {
+            std::lock_guard pending_lk{pending_mtx};
+            pending.emplace(tag, &p);
+        } catch (...) {
+            return -ENOMEM;
+        }
+        if (!send_locked(op, tag, region, offset, size, iov, iovcnt) || !flush_locked()) [[unlikely]] {
+            std::lock_guard pending_lk{pending_mtx};
+            pending.erase(tag);
+            return -EIO;
+        }
+    }
+    std::unique_lock lk{pending_mtx};
+    p.cv.wait(lk, [&p] { return p.done; });
+    return p.status;
+}
+bool RemoteStore::post(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size, const void* payload) noexcept
+{
+    const iovec iov{const_cast<void*>(payload), payload != nullptr ? size : 0};
+    return post(op, region, offset, size, &iov, 1);
+}
+bool RemoteStore::post(PageServerProtocol::Op op, uint64_t region, uint64_t offset, uint64_t size, const iovec* iov, int iovcnt) noexcept
+{
+    std::lock_guard lk{send_mtx};
+    return send_locked(op, next_tag++, region, offset, size, iov, iovcnt) && (send_buf.size() < batch_bytes || flush_locked());
+}
+bool RemoteStore::send_locked(PageServerProtocol::Op op, uint64_t tag, uint64_t region, uint64_t offset, uint64_t size, const iovec* iov, int iovcnt) noexcept
+{
+    const PageServerProtocol::RequestHeader header{.op = op, .reserved = 0, .tag = tag, .region = region, .offset = offset, .size = size};
+    const auto header_ptr = reinterpret_cast<const std::byte*>(&header);
+    size_t payload_size = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        payload_size += iov[i].iov_len;
+    }
+    const auto rollback = send_buf.size();
+    try {
+        send_buf.insert(send_buf.end(), header_ptr, header_ptr + sizeof(header));
+        if (payload_size >= batch_bytes) {  // too large to be worth copying
+            if (!flush_locked()) [[unlikely]] {
+                return false;
+            }
+            for (int i = 0; i < iovcnt; i++) {
+                if (!PageServerProtocol::send_all(sock_fd, iov[i].iov_base, iov[i].iov_len)) [[unlikely]] {
+                    shutdown(sock_fd, SHUT_RDWR);  // part of the frame may be out
+                    return false;
+                }
+            }
+            return true;
+        }
+        for (int i = 0; i < iovcnt; i++) {
+            const auto payload_ptr = static_cast<const std::byte*>(iov[i].iov_base);
+            send_buf.insert(send_buf.end(), payload_ptr, payload_ptr + iov[i].iov_len);
+        }
+    } catch (...) {
+        send_buf.resize(rollback);  // nothing of the frame has been sent, so the stream stays in step
+        return false;
+    }
+    return true;
+}
+bool RemoteStore::flush_locked() noexcept
+{
+    const auto res = PageServerProtocol::send_all(sock_fd, send_buf.data(), send_buf.size());
+    send_buf.clear();
+    if (!res) [[unlikely]] {  // a frame may have been cut short, so the server would misparse everything after it:
+        shutdown(sock_fd, SHUT_RDWR);  // let receive_loop fail every pending request instead
+    }
+    return res;
+}
+
+void RemoteStore::receive_loop() noexcept
+{
+    auto reader = std::unique_ptr<PageServerProtocol::BufferedReader>{new (std::nothrow) PageServerProtocol::BufferedReader{sock_fd}};
+    for (PageServerProtocol::ResponseHeader header; reader != nullptr && reader->read_exact(&header, sizeof(header));) {
+        Pending* p = nullptr;
+        {
+            std::lock_guard lk{pending_mtx};
+            if (const auto it = pending.find(header.tag); it != pending.end()) {
+                p = it->second;
+                pending.erase(it);
+            }
+        }
+        if (p == nullptr) {  // acknowledgement of a posted free; a failure only leaks memory on the server
+            continue;
+        }
+        bool broken = false;
+        if (p->buf != nullptr && header.status > 0) {
+            if (static_cast<uint64_t>(header.status) > p->size) [[unlikely]] {  // would overflow the buffer: the stream cannot be trusted
+                header.status = -EIO;
+                broken = true;
+            } else if (!reader->read_exact(p->buf, static_cast<size_t>(header.status))) {
+                header.status = -EIO;
+            }
+        }
+        {
+            std::lock_guard lk{pending_mtx};
+            p->status = header.status;
+            p->done = true;
+            p->cv.notify_one();
+        }
+        if (broken) [[unlikely]] {
+            shutdown(sock_fd, SHUT_RDWR);
+            break;
+        }
+    }
+
+    // the connection is gone: fail every request still waiting
+    std::lock_guard lk{pending_mtx};
+    for (auto& [tag, p] : pending) {
+        p->status = -EIO;
+        p->done = true;
+        p->cv.notify_one();
+    }
+    pending.clear();
+}
+
+}  // namespace FarMalloc
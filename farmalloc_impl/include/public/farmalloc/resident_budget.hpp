@@ -0,0 +1,83 @@
+#pragma once
+
+#include <farmalloc/far_memory_group.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+// Keeps the resident memory of the swappable regions of some groups under a byte limit.
+// Give an allocator a group of its own to budget it alone.
+// Over the limit, enforce has the pager evict resident pages of the groups' far regions, from a rotating cursor,
+// until the resident size is down to the low watermark. It never changes the mode of a group or region:
+// the regions of a group in local mode count against the limit but are left alone.
+// Evicting single pages needs the in-tree pager (FARMALLOC_PAGER=uffd). Umap cannot, so there the limits of all the
+// budgets of the process size its one buffer instead, which takes effect only for budgets made before the first group goes far.
+// Memory pressure reported by a PSI trigger on `pressure_path` (memory.pressure of a cgroup v2, or /proc/pressure/memory)
+// shrinks the limit by `pressure_factor` until `pressure_hold` has passed without another event.
+struct ResidentBudget {
+    struct Config {
+        size_t limit;
+        double low_watermark = 0.9;  // fraction of the limit that eviction aims at and readmission stays under
+        std::string pressure_path{};  // empty: ignore memory pressure
+        // the trigger fires when tasks stall on memory for `pressure_stall` within `pressure_window`;
+        // unprivileged processes may only use windows that are multiples of 2 s
+        std::chrono::microseconds pressure_stall{150'000}, pressure_window{2'000'000};
+        double pressure_factor = 0.5;
+        std::chrono::milliseconds pressure_hold{1'000};
+    };
+
+    const Config config;
+    const std::vector<FarMemoryGroup*> groups;
+
+    static std::atomic_size_t total_limit;  // of the budgets alive
+
+    std::atomic_size_t last_resident{0};  // as measured by the last enforce
+    std::atomic_uint64_t n_evicted{0};  // runs of pages released
+    std::atomic_uint64_t evicted_bytes{0};
+    std::atomic_uint64_t n_pressure_events{0};
+
+    inline ResidentBudget(std::initializer_list<FarMemoryGroup*> groups, Config config);
+    ResidentBudget(const ResidentBudget&) = delete;
+    ResidentBudget& operator=(const ResidentBudget&) = delete;
+    inline ~ResidentBudget();
+
+    // the limit in force now, shrunk while under pressure
+    inline size_t effective_limit() noexcept;
+    // measure, then evict pages for at most `budget`; returns whether the resident size is within the limit
+    inline bool enforce(std::chrono::nanoseconds budget = std::chrono::nanoseconds::max());
+
+private:
+    struct Region {
+        void* ptr;
+        size_t size;
+        size_t resident;
+        FarMemoryGroup* group;
+        bool far;
+    };
+
+    std::mutex mtx;
+    int pressure_fd = -1;
+    std::chrono::steady_clock::time_point last_pressure{};
+    uintptr_t evict_cursor = 0;
+    std::vector<unsigned char> residency;  // mincore buffer
+
+    inline bool covers(const FarMemoryGroup* group) const noexcept;
+    inline void poll_pressure() noexcept;
+    inline std::vector<Region> measure();
+    // evict resident pages of a far region until about `excess` bytes are gone; returns the bytes evicted
+    inline size_t trim(const Region& region, size_t excess);
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/resident_budget.ipp>
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <farmalloc/resident_budget.hpp>
+
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+#include <farmalloc/pager.hpp>
+
+#include <fcntl.h>     // open
+#include <poll.h>      // poll
+#include <sys/mman.h>  // mincore
+#include <unistd.h>    // close, sysconf, write
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+
+namespace FarMalloc
+{
+
+ResidentBudget::ResidentBudget(std::initializer_list<FarMemoryGroup*> groups, Config config)
+    : config{std::move(config)}, groups{groups}
+{
+    if (this->groups.empty() || this->config.limit == 0) [[unlikely]] {
+        throw std::logic_error{"ResidentBudget: no group or a zero limit"};
+    }
+    Pager::size_buffer(total_limit.fetch_add(this->config.limit, std::memory_order_relaxed) + this->config.limit);
+    if (this->config.pressure_path.empty()) {
+        return;
+    }
+    pressure_fd = ::open(this->config.pressure_path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (pressure_fd == -1) [[unlikely]] {
+        const int err = errno;
+        total_limit.fetch_sub(this->config.limit, std::memory_order_relaxed);
+        throw std::system_error{err, std::generic_category(), "open memory.pressure"};
+    }
+    const auto trigger = "some " + std::to_string(this->config.pressure_stall.count())
+                         + " " + std::to_string(this->config.pressure_window.count());
+    // the trigger lives as long as the file stays open; the terminating null is part of the expected write
+    if (::write(pressure_fd, trigger.c_str(), trigger.size() + 1) < 0) [[unlikely]] {
+        const int err = errno;
+        ::close(pressure_fd);
+        total_limit.fetch_sub(this->config.limit, std::memory_order_relaxed);
+        throw std::system_error{err, std::generic_category(), "write PSI trigger"};
+    }
+}
+
+ResidentBudget::~ResidentBudget()
+{
+    total_limit.fetch_sub(config.limit, std::memory_order_relaxed);
+    if (pressure_fd != -1) {
+        ::close(pressure_fd);
+    }
+}
+
+bool ResidentBudget::covers(const FarMemoryGroup* group) const noexcept
+{
+    return std::find(groups.begin(), groups.end(), group) != groups.end();
+}
+
+void ResidentBudget::poll_pressure() noexcept
+{
+    if (pressure_fd == -1) {
+        return;
+    }
+    pollfd pfd{.fd = pressure_fd, .events = POLLPRI, .revents = 0};
+    if (::poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLPRI)) {
+        last_pressure = std::chrono::steady_clock::now();
+        n_pressure_events.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+size_t ResidentBudget::effective_limit() noexcept
+{
+    std::lock_guard lock{mtx};
+    poll_pressure();
+    if (last_pressure != std::chrono::steady_clock::time_point{}
+        && std::chrono::steady_clock::now() - last_pressure < config.pressure_hold) {
+        return static_cast<size_t>(static_cast<double>(config.limit) * config.pressure_factor);
+    }
+    return config.limit;
+}
+
+std::vector<ResidentBudget::Region> ResidentBudget::measure()
+{
+    static const auto sys_page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    std::vector<Region> regions;
+    LocalMemoryStore::mapping.for_each([&](const RegionEntry& entry) {
+        if (covers(entry.group)) {
+            regions.push_back({entry.ptr, entry.size, 0, entry.group, entry.far});
+        }
+    });
+    for (auto& region : regions) {
+        residency.resize((region.size + sys_page_size - 1) / sys_page_size);
+        // a region freed since the walk reads as not resident
+        if (::mincore(region.ptr, region.size, residency.data()) == 0) {
+            region.resident = sys_page_size * static_cast<size_t>(std::count_if(residency.begin(), residency.end(), [](unsigned char c) { return c & 1; }));
+        }
+    }
+    return regions;
+}
+
+size_t ResidentBudget::trim(const Region& region, size_t excess)
+{
+    static const auto sys_page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    constexpr size_t MaxRun = 64;  // pager pages released at once
+    const auto unit = std::max(PageSize, sys_page_size);
+    const auto sys_pages_per_unit = unit / sys_page_size;
+
+    // the region must stay far while its pages are released
+    std::shared_lock lock{region.group->mode_mtx};
+    if (const auto entry = LocalMemoryStore::mapping.find(region.ptr); !entry || entry->ptr != region.ptr || !entry->far) {
+        return 0;
+    }
+    residency.resize((region.size + sys_page_size - 1) / sys_page_size);
+    if (::mincore(region.ptr, region.size, residency.data()) != 0) {
+        return 0;
+    }
+
+    const auto begin = reinterpret_cast<uintptr_t>(region.ptr);
+    size_t evicted = 0, run_begin = 0, run_length = 0, run_resident = 0;
+    const auto release_run = [&] {
+        if (run_length != 0) {
+            Pager::release(begin + run_begin * unit, begin + (run_begin + run_length) * unit);
+            evicted += run_resident;
+            n_evicted.fetch_add(1, std::memory_order_relaxed);
+            evicted_bytes.fetch_add(run_resident, std::memory_order_relaxed);
+        }
+        run_length = run_resident = 0;
+    };
+    for (size_t idx = 0; idx < region.size / unit && evicted + run_resident < excess; idx++) {
+        const auto first = residency.begin() + static_cast<ptrdiff_t>(idx * sys_pages_per_unit);
+        const auto resident = sys_page_size * static_cast<size_t>(std::count_if(first, first + static_cast<ptrdiff_t>(sys_pages_per_unit), [](unsigned char c) { return c & 1; }));
+        if (resident == 0 || run_length == MaxRun) {
+            release_run();
+        }
+        if (resident != 0) {
+            if (run_length == 0) {
+                run_begin = idx;
+            }
+            run_length++;
+            run_resident += resident;
+        }
+    }
+    release_run();
+    return evicted;
+}
+
+bool ResidentBudget::enforce(std::chrono::nanoseconds budget)
+{
+    const auto limit = effective_limit();
+    const auto low = static_cast<size_t>(static_cast<double>(limit) * config.low_watermark);
+    const auto start = std::chrono::steady_clock::now();
+    const auto expired = [&] { return std::chrono::steady_clock::now() - start >= budget; };
+
+    std::lock_guard lock{mtx};
+    auto regions = measure();
+    size_t resident = 0;
+    for (const auto& region : regions) {
+        resident += region.resident;
+    }
+
+    if (resident > limit) {
+        // resume after the last region trimmed, wrapping around once
+        const auto first = std::lower_bound(regions.begin(), regions.end(), evict_cursor,
+            [](const Region& region, uintptr_t cursor) { return reinterpret_cast<uintptr_t>(region.ptr) < cursor; });
+        std::rotate(regions.begin(), first, regions.end());
+        for (const auto& region : regions) {
+            if (resident <= low || expired()) {
+                break;
+            }
+            if (!region.far || region.resident == 0) {
+                continue;
+            }
+            resident -= std::min(trim(region, resident - low), resident);
+            evict_cursor = reinterpret_cast<uintptr_t>(region.ptr) + region.size;
+        }
+    }
+    last_resident.store(resident, std::memory_order_relaxed);
+    return resident <= limit;
+}
+
+}  // namespace FarMalloc
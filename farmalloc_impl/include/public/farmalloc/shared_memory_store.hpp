@@ -0,0 +1,99 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace FarMalloc
+{
+
+// Keeps the far copy of each page in a slot of a shared-memory segment (POSIX shared memory or a memfd) that several processes attach to,
+// so that they all draw from one pool under one budget instead of each sizing its own.
+// A region reserves a slot for each of its pages against the budget when it is created, and fails with bad_alloc there if they
+// do not fit, so that writing a page back never runs out of slots. A page takes a slot when first written and gives it back,
+// with its memory, when discarded or when its region is destroyed, through a lock-free free list kept in the segment itself.
+// Slots and reservations are tagged with the attachment of their process, so the ones of a process that died are reclaimed
+// by the next process that attaches or runs short; the processes must share a PID namespace. A child forked after open must
+// close and open the store again before using it.
+struct SharedMemoryStore : BackingStore {
+    inline static constexpr uint64_t Magic = 0x324d454d48534d46;  // "FMSHMEM2"
+    inline static constexpr uint32_t MaxAttachments = 256;
+
+    // a process attached to the segment
+    struct Attachment {
+        std::atomic_uint32_t pid;  // 0 if free, Reclaiming while the slots of a dead process are taken back
+        std::atomic_uint64_t n_reserved;  // slots reserved by its regions
+    };
+    inline static constexpr uint32_t Reclaiming = UINT32_MAX;
+
+    // at offset 0 of the segment, followed by the free list links and slot owners and, from the next page boundary, the slots
+    struct Segment {
+        uint64_t magic;
+        uint64_t page_size;
+        uint64_t n_slots;
+        std::atomic_uint64_t free_head;  // slot index in the low half (NoSlot if empty), ABA tag in the high half
+        std::atomic_uint64_t n_touched;  // slots from here on have never been handed out
+        std::atomic_uint64_t n_used;
+        std::atomic_uint64_t n_reserved;  // over all attachments
+        std::atomic_uint64_t budget;  // in slots
+        std::atomic_uint32_t ready;
+        std::array<Attachment, MaxAttachments> attachments;
+    };
+    inline static constexpr uint32_t NoSlot = UINT32_MAX;
+    static_assert(std::atomic_uint64_t::is_always_lock_free && std::atomic_uint32_t::is_always_lock_free && std::atomic_uint16_t::is_always_lock_free,
+                  "the segment is shared between processes");
+
+    static int fd;
+    static size_t mapped_size;
+    static Segment* segment;
+    static std::atomic_uint32_t* next_slot;
+    static std::atomic_uint16_t* slot_owner;  // attachment index + 1 of the process holding each slot, or 0 if free
+    static std::byte* slots;
+    static uint32_t attachment;  // of this process
+
+    std::atomic_uint32_t* slot_tab;  // per page: its slot + 1, or 0 if it reads as zeros
+
+    inline SharedMemoryStore(size_t size);
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+
+    // attach to the segment `name` (see shm_open(3)), creating it with room for `capacity` bytes of pages if it does not exist;
+    // every swappable arena created afterwards is backed by this store
+    inline static void open(const char* name, size_t capacity);
+    // the same for a segment passed down as a file descriptor, e.g. from memfd_create(2): initialized if still empty, and owned from now on
+    inline static void open_fd(int fd, size_t capacity);
+    inline static void close();
+    inline static bool is_open() noexcept { return fd != -1; }
+
+    // the budget is shared by all the processes attached, and any of them may move it; it never exceeds the segment
+    // lowering it below what is reserved refuses new regions and leaves the existing ones alone
+    inline static void set_budget(size_t bytes) noexcept;
+    inline static size_t budget() noexcept;
+    inline static size_t reserved_bytes() noexcept;
+    inline static size_t used_bytes() noexcept;
+    // take back the slots and reservations of the processes that died attached; returns how many processes they were
+    inline static size_t reclaim() noexcept;
+
+private:
+    inline static void attach(int fd, size_t capacity, bool create);
+    inline static void reserve(uint64_t n_slots);
+    inline static void unreserve(uint64_t n_slots) noexcept;
+    // NoSlot only if the segment is spent, which the reservations rule out but for racing writes of one page
+    inline static uint32_t take_slot() noexcept;
+    inline static void give_back_slot(uint32_t slot) noexcept;
+    inline static std::byte* slot_data(uint32_t slot) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/shared_memory_store.ipp>
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <farmalloc/shared_memory_store.hpp>
+
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <errno.h>     // errno, E*
+#include <fcntl.h>     // O_*
+#include <signal.h>    // kill
+#include <sys/mman.h>  // madvise, mmap, munmap, shm_open
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close, ftruncate, getpid
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+
+namespace FarMalloc
+{
+
+SharedMemoryStore::SharedMemoryStore(size_t size)
+{
+    assert(is_open() && size % PageSize == 0);
+    slot_tab = new std::atomic_uint32_t[size / PageSize]{};
+    try {
+        reserve(size / PageSize);
+    } catch (...) {
+        delete[] slot_tab;
+        throw;
+    }
+}
+void SharedMemoryStore::destroy(size_t size)
+{
+    discard(0, size);
+    delete[] slot_tab;
+    unreserve(size / PageSize);
+}
+void SharedMemoryStore::populate(const std::byte* src, size_t size)
+{
+    if (write_to_store(const_cast<char*>(reinterpret_cast<const char*>(src)), size, 0) == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "SharedMemoryStore::populate"};
+    }
+}
+void SharedMemoryStore::discard(off_t off, size_t size) noexcept
+{
+    assert(off % PageSize == 0 && size % PageSize == 0);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t page_idx = first; page_idx < first + size / PageSize; page_idx++) {
+        if (const auto slot = slot_tab[page_idx].exchange(0, std::memory_order_acq_rel); slot != 0) {
+            give_back_slot(slot - 1);
+        }
+    }
+}
+
+ssize_t SharedMemoryStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(off % PageSize == 0 && size_in_bytes % PageSize == 0);
+    LocalMemoryStore::read_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t i = 0; i < size_in_bytes / PageSize; i++) {
+        if (const auto slot = slot_tab[first + i].load(std::memory_order_acquire); slot == 0) {
+            std::memset(buf + i * PageSize, 0, PageSize);
+        } else {
+            std::memcpy(buf + i * PageSize, slot_data(slot - 1), PageSize);
+        }
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+ssize_t SharedMemoryStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(off % PageSize == 0 && size_in_bytes % PageSize == 0);
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t i = 0; i < size_in_bytes / PageSize; i++) {
+        auto slot = slot_tab[first + i].load(std::memory_order_acquire);
+        if (slot == 0) {
+            const auto taken = take_slot();
+            if (taken == NoSlot) [[unlikely]] {
+                errno = ENOSPC;  // only a write racing with another of the same page can get here
+                return -1;
+            }
+            // the page is written by one pager thread at a time, but a racing writer only costs the slot just taken
+            if (slot_tab[first + i].compare_exchange_strong(slot, taken + 1, std::memory_order_acq_rel)) {
+                slot = taken + 1;
+            } else {
+                give_back_slot(taken);
+            }
+        }
+        std::memcpy(slot_data(slot - 1), buf + i * PageSize, PageSize);
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+
+
+void SharedMemoryStore::open(const char* name, size_t capacity)
+{
+    if (is_open()) {
+        throw std::logic_error{"SharedMemoryStore is already open"};
+    }
+    // exactly one process creates and initializes the segment
+    int new_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    const bool create = (new_fd != -1);
+    if (!create && errno == EEXIST) {
+        new_fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+    }
+    if (new_fd == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "shm_open"};
+    }
+    attach(new_fd, capacity, create);
+}
+void SharedMemoryStore::open_fd(int new_fd, size_t capacity)
+{
+    if (is_open()) {
+        throw std::logic_error{"SharedMemoryStore is already open"};
+    }
+    struct stat st;
+    if (fstat(new_fd, &st) == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "fstat"};
+    }
+    attach(new_fd, capacity, st.st_size == 0);
+}
+void SharedMemoryStore::close()
+{
+    if (is_open()) {
+        auto& self = segment->attachments[attachment];
+        segment->n_reserved.fetch_sub(self.n_reserved.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        self.pid.store(0, std::memory_order_release);
+        munmap(segment, mapped_size);
+        segment = nullptr;
+        next_slot = nullptr;
+        slot_owner = nullptr;
+        slots = nullptr;
+        if (::close(fd) == -1) [[unlikely]] {
+            fd = -1;
+            throw std::system_error{errno, std::generic_category(), "close"};
+        }
+        fd = -1;
+    }
+}
+
+void SharedMemoryStore::attach(int new_fd, size_t capacity, bool create)
+{
+    const auto layout_size = [](uint64_t n_slots) {
+        const auto header_size = (sizeof(Segment) + (sizeof(std::atomic_uint32_t) + sizeof(std::atomic_uint16_t)) * n_slots + PageSize - 1) / PageSize * PageSize;
+        return header_size + n_slots * PageSize;
+    };
+    const auto fail = [new_fd](int err, const char* what) {
+        ::close(new_fd);
+        throw std::system_error{err, std::generic_category(), what};
+    };
+
+    uint64_t n_slots = std::min<uint64_t>(capacity / PageSize, NoSlot);
+    if (create) {
+        if (ftruncate(new_fd, static_cast<off_t>(layout_size(n_slots))) == -1) [[unlikely]] {
+            fail(errno, "ftruncate");
+        }
+    } else {
+        // the creator may not have sized the segment yet
+        struct stat st;
+        for (int n_tries = 0;; n_tries++) {
+            if (fstat(new_fd, &st) == -1) [[unlikely]] {
+                fail(errno, "fstat");
+            }
+            if (st.st_size != 0) {
+                break;
+            } else if (n_tries == 1000) [[unlikely]] {
+                fail(ETIMEDOUT, "SharedMemoryStore: segment never initialized");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        n_slots = std::min<uint64_t>(static_cast<uint64_t>(st.st_size) / PageSize, NoSlot);
+        while (n_slots != 0 && layout_size(n_slots) > static_cast<uint64_t>(st.st_size)) {
+            n_slots--;
+        }
+    }
+
+    const auto size = layout_size(n_slots);
+    auto* const mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0);
+    if (mapped == MAP_FAILED) [[unlikely]] {
+        fail(errno, "mmap");
+    }
+    auto* const seg = static_cast<Segment*>(mapped);
+
+    if (create) {
+        // a fresh segment reads as zeros, so only the non-zero fields need setting
+        seg->magic = Magic;
+        seg->page_size = PageSize;
+        seg->n_slots = n_slots;
+        seg->free_head.store(NoSlot, std::memory_order_relaxed);
+        seg->budget.store(n_slots, std::memory_order_relaxed);
+        seg->ready.store(1, std::memory_order_release);
+    } else {
+        for (int n_tries = 0; seg->ready.load(std::memory_order_acquire) == 0; n_tries++) {
+            if (n_tries == 1000) [[unlikely]] {
+                munmap(mapped, size);
+                fail(ETIMEDOUT, "SharedMemoryStore: segment never initialized");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+        if (seg->magic != Magic || seg->page_size != PageSize || seg->n_slots != n_slots) [[unlikely]] {
+            munmap(mapped, size);
+            fail(EINVAL, "SharedMemoryStore: segment of another layout or page size");
+        }
+    }
+
+    segment = seg;
+    next_slot = reinterpret_cast<std::atomic_uint32_t*>(seg + 1);
+    slot_owner = reinterpret_cast<std::atomic_uint16_t*>(next_slot + n_slots);
+    slots = static_cast<std::byte*>(mapped) + (size - n_slots * PageSize);
+    attachment = MaxAttachments;
+    // attaching is when the leftovers of dead processes are looked for, which also frees their entries
+    reclaim();
+    for (uint32_t idx = 0; idx < MaxAttachments; idx++) {
+        uint32_t free_pid = 0;
+        if (seg->attachments[idx].pid.compare_exchange_strong(free_pid, static_cast<uint32_t>(getpid()), std::memory_order_acq_rel)) {
+            attachment = idx;
+            break;
+        }
+    }
+    if (attachment == MaxAttachments) [[unlikely]] {
+        segment = nullptr;
+        next_slot = nullptr;
+        slot_owner = nullptr;
+        slots = nullptr;
+        munmap(mapped, size);
+        fail(EUSERS, "SharedMemoryStore: too many processes attached");
+    }
+    fd = new_fd;
+    mapped_size = size;
+}
+
+void SharedMemoryStore::set_budget(size_t bytes) noexcept
+{
+    segment->budget.store(std::min<uint64_t>(bytes / PageSize, segment->n_slots), std::memory_order_relaxed);
+}
+size_t SharedMemoryStore::budget() noexcept
+{
+    return segment->budget.load(std::memory_order_relaxed) * PageSize;
+}
+size_t SharedMemoryStore::reserved_bytes() noexcept
+{
+    return segment->n_reserved.load(std::memory_order_relaxed) * PageSize;
+}
+size_t SharedMemoryStore::used_bytes() noexcept
+{
+    return segment->n_used.load(std::memory_order_relaxed) * PageSize;
+}
+
+size_t SharedMemoryStore::reclaim() noexcept
+{
+    size_t n_reclaimed = 0;
+    for (uint32_t idx = 0; idx < MaxAttachments; idx++) {
+        auto& dead = segment->attachments[idx];
+        auto pid = dead.pid.load(std::memory_order_acquire);
+        if (pid == 0 || pid == Reclaiming || idx == attachment || !(kill(static_cast<pid_t>(pid), 0) == -1 && errno == ESRCH)) {
+            continue;
+        }
+        // one process takes each dead attachment back
+        if (!dead.pid.compare_exchange_strong(pid, Reclaiming, std::memory_order_acq_rel)) {
+            continue;
+        }
+        const auto tag = static_cast<uint16_t>(idx + 1);
+        for (uint32_t slot = 0; slot < segment->n_touched.load(std::memory_order_acquire); slot++) {
+            if (auto owner = tag; slot_owner[slot].compare_exchange_strong(owner, 0, std::memory_order_acq_rel)) {
+                give_back_slot(slot);
+            }
+        }
+        segment->n_reserved.fetch_sub(dead.n_reserved.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        dead.pid.store(0, std::memory_order_release);
+        n_reclaimed++;
+    }
+    return n_reclaimed;
+}
+
+void SharedMemoryStore::reserve(uint64_t n_slots)
+{
+    for (bool reclaimed = false;; reclaimed = true) {
+        if (segment->n_reserved.fetch_add(n_slots, std::memory_order_relaxed) + n_slots <= segment->budget.load(std::memory_order_relaxed)) {
+            break;
+        }
+        segment->n_reserved.fetch_sub(n_slots, std::memory_order_relaxed);
+        if (reclaimed || reclaim() == 0) [[unlikely]] {
+            throw std::bad_alloc{};
+        }
+    }
+    segment->attachments[attachment].n_reserved.fetch_add(n_slots, std::memory_order_relaxed);
+}
+void SharedMemoryStore::unreserve(uint64_t n_slots) noexcept
+{
+    segment->attachments[attachment].n_reserved.fetch_sub(n_slots, std::memory_order_relaxed);
+    segment->n_reserved.fetch_sub(n_slots, std::memory_order_relaxed);
+}
+
+uint32_t SharedMemoryStore::take_slot() noexcept
+{
+    if (segment->n_used.fetch_add(1, std::memory_order_acq_rel) >= segment->n_slots) [[unlikely]] {
+        segment->n_used.fetch_sub(1, std::memory_order_relaxed);
+        return NoSlot;
+    }
+    // now a slot is certain to be free: a slot given back joins the free list before n_used drops
+    const auto owned = [](uint32_t slot) {
+        slot_owner[slot].store(static_cast<uint16_t>(attachment + 1), std::memory_order_release);
+        return slot;
+    };
+    for (;;) {
+        auto head = segment->free_head.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head) != NoSlot) {
+            const auto slot = static_cast<uint32_t>(head);
+            const auto next = next_slot[slot].load(std::memory_order_relaxed);
+            if (segment->free_head.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | next, std::memory_order_acq_rel)) {
+                return owned(slot);
+            }
+        }
+        auto touched = segment->n_touched.load(std::memory_order_relaxed);
+        while (touched < segment->n_slots) {
+            if (segment->n_touched.compare_exchange_weak(touched, touched + 1, std::memory_order_acq_rel)) {
+                return owned(static_cast<uint32_t>(touched));
+            }
+        }
+    }
+}
+void SharedMemoryStore::give_back_slot(uint32_t slot) noexcept
+{
+    // hand the memory back to the host while the slot is still ours; failure only costs memory
+    madvise(slot_data(slot), PageSize, MADV_REMOVE);
+    slot_owner[slot].store(0, std::memory_order_relaxed);
+
+    auto head = segment->free_head.load(std::memory_order_relaxed);
+    do {
+        next_slot[slot].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while (!segment->free_head.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | slot, std::memory_order_release, std::memory_order_relaxed));
+    segment->n_used.fetch_sub(1, std::memory_order_release);
+}
+std::byte* SharedMemoryStore::slot_data(uint32_t slot) noexcept
+{
+    return slots + size_t{slot} * PageSize;
+}
+
+}  // namespace FarMalloc
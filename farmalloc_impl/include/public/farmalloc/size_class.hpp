@@ -2,6 +2,7 @@
 
 #include <farmalloc/collective_allocator_params.hpp>
 #include <farmalloc/page_size.hpp>
+#include <util/enough_unsigned_integer.hpp>
 
 #include <algorithm>
 #include <array>
@@ -28,7 +29,8 @@ inline constexpr size_t NAllocClasses = NAllocClassesInDoublingSize  // Smallest
                                         + (std::bit_width(PageSize / SmallestAllocSize) - 1) * NAllocClassesInDoublingSize
                                         - 1;  // exclude (PageSize * NAllocClassesInDoublingSize)
 
-using SmallAllocSizeType = uint16_t;
+// every class is below PageSize * NAllocClassesInDoublingSize
+using SmallAllocSizeType = FarMemory::Utility::EnoughUnsignedInteger<std::bit_width(PageSize * NAllocClassesInDoublingSize)>;
 constexpr std::array<SmallAllocSizeType, NAllocClasses> AllocClassIdx2SizeTab = [] {
     std::array<SmallAllocSizeType, NAllocClasses> res;
     size_t idx = 0;
@@ -92,7 +94,8 @@ inline constexpr size_t alloc_class_idx2n_pages(size_t class_idx) noexcept
 }
 
 
-using SlabNSlotsType = uint16_t;
+// every class is a multiple of SmallestAllocSize, so a slab of the fewest pages has at most PageSize / SmallestAllocSize slots
+using SlabNSlotsType = FarMemory::Utility::EnoughUnsignedInteger<std::bit_width(PageSize / SmallestAllocSize)>;
 constexpr std::array<SlabNSlotsType, NAllocClasses> AllocClassIdx2NSlotsTab = [] {
     std::array<SlabNSlotsType, NAllocClasses> res;
     for (size_t idx = 0; idx < res.size(); idx++) {
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <farmalloc/async_file_store.hpp>
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/checkpoint_store.hpp>
+#include <farmalloc/compressed_store.hpp>
+#include <farmalloc/discarding_store.hpp>
+#include <farmalloc/emulated_store.hpp>
+#include <farmalloc/fault_trace.hpp>
+#include <farmalloc/file_store.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+#include <farmalloc/prefetching_store.hpp>
+#include <farmalloc/remote_store.hpp>
+#include <farmalloc/shared_memory_store.hpp>
+#include <farmalloc/store_factory.hpp>
+#include <farmalloc/store_stats.hpp>
+#include <farmalloc/tiered_store.hpp>
+#include <farmalloc/writeback_store.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+
+namespace FarMalloc
+{
+
+// in-place storage for the store of a swappable region; the store is made by the allocator's StoreFactory,
+// wrapped by the (heap-allocated) checkpoint decorator if the region is restored, optionally by the fabric emulation decorator, then by the (heap-allocated) writeback, prefetching, discarding, tracing and statistics decorators
+struct StoreBuffer {
+    inline static constexpr size_t BufSize = std::max({sizeof(LocalMemoryStore), sizeof(FileStore), sizeof(AsyncFileStore), sizeof(CompressedStore), sizeof(RemoteStore), sizeof(SharedMemoryStore), sizeof(TieredStore)}),
+                                   BufAlign = std::max({alignof(LocalMemoryStore), alignof(FileStore), alignof(AsyncFileStore), alignof(CompressedStore), alignof(RemoteStore), alignof(SharedMemoryStore), alignof(TieredStore)});
+
+    BackingStore* store;
+    std::byte* region;
+    CheckpointStore* restored;
+    WritebackStore* writeback;
+    PrefetchingStore* prefetcher;
+    DiscardingStore* discarding;
+    TracingStore* tracer;
+    bool instrumented;
+    alignas(BufAlign) std::byte buf[BufSize];
+    alignas(EmulatedStore) std::byte decorator_buf[sizeof(EmulatedStore)];
+
+    // `region` is where the store gets umapped; `block_size` is the unit the arena hands out, if larger than a page
+    // `checkpoint`: the region's contents are in that file from `checkpoint_off` on, to be read as pages fault
+    inline BackingStore* construct(void* region, size_t size, ArenaKind kind, StoreFactory factory, size_t block_size = PageSize,
+        std::shared_ptr<const CheckpointStore::File> checkpoint = nullptr, off_t checkpoint_off = 0);
+    inline void destroy(size_t size);
+
+    // the allocator freed [ptr, ptr + size) inside the region; only the pages it covers entirely are discarded
+    inline void discard(void* ptr, size_t size) noexcept;
+    // the allocator is handing [ptr, ptr + size) out again
+    inline void reuse(void* ptr, size_t size) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/store_buffer.ipp>
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <farmalloc/store_buffer.hpp>
+
+#include <farmalloc/checkpoint_store.hpp>
+#include <farmalloc/discarding_store.hpp>
+#include <farmalloc/emulated_store.hpp>
+#include <farmalloc/fault_trace.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
+#include <farmalloc/prefetching_store.hpp>
+#include <farmalloc/store_factory.hpp>
+#include <farmalloc/store_stats.hpp>
+#include <farmalloc/writeback_store.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+
+namespace FarMalloc
+{
+
+BackingStore* StoreBuffer::construct(void* region, size_t size, ArenaKind kind, StoreFactory factory, size_t block_size,
+    std::shared_ptr<const CheckpointStore::File> checkpoint, off_t checkpoint_off)
+{
+    store = factory.make(buf, size);
+    restored = nullptr;
+    if (checkpoint) {
+        try {
+            store = restored = new CheckpointStore{store, std::move(checkpoint), checkpoint_off, size};
+        } catch (...) {
+            store->destroy(size);
+            throw;
+        }
+    }
+    if (EmulatedStore::is_enabled()) {
+        store = std::construct_at(reinterpret_cast<EmulatedStore*>(decorator_buf), store);
+    }
+    this->region = static_cast<std::byte*>(region);
+    writeback = nullptr;
+    prefetcher = nullptr;
+    discarding = nullptr;
+    tracer = nullptr;
+    instrumented = InstrumentedStore::is_enabled();
+    try {
+        if (WritebackStore::is_enabled()) {
+            store = writeback = new WritebackStore{store};
+        }
+        if (PrefetchingStore::is_enabled()) {
+            store = prefetcher = new PrefetchingStore{store, region, size, block_size};
+        }
+        store = discarding = new DiscardingStore{store, size};
+        if (FaultTrace::is_enabled()) {
+            store = tracer = new TracingStore{store, kind};
+        }
+        if (instrumented) {
+            store = new InstrumentedStore{store, kind};
+        }
+    } catch (...) {
+        store->destroy(size);
+        delete tracer;
+        delete discarding;
+        delete prefetcher;
+        delete writeback;
+        delete restored;
+        throw;
+    }
+    return store;
+}
+void StoreBuffer::destroy(size_t size)
+{
+    store->destroy(size);
+    if (instrumented) {
+        delete static_cast<InstrumentedStore*>(store);
+    }
+    delete tracer;
+    delete discarding;
+    delete prefetcher;
+    delete writeback;
+    delete restored;
+}
+
+void StoreBuffer::discard(void* ptr, size_t size) noexcept
+{
+    const auto begin = (reinterpret_cast<uintptr_t>(ptr) + PageSize - 1) / PageSize * PageSize,
+               end = (reinterpret_cast<uintptr_t>(ptr) + size) / PageSize * PageSize;
+    if (begin < end) {
+        LocalMemoryStore::discard(reinterpret_cast<void*>(begin), end - begin);
+    }
+}
+void StoreBuffer::reuse(void* ptr, size_t size) noexcept
+{
+    discarding->reuse(static_cast<std::byte*>(ptr) - region, size);
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <cstddef>
+
+
+namespace FarMalloc
+{
+
+// Constructs the store of each swappable region of an allocator, so that allocators in one process can use different backends.
+// `make` builds the store of a region of `size` bytes, either in place in `buf`
+// (StoreBuffer::BufSize bytes aligned to StoreBuffer::BufAlign) or elsewhere; it is released by BackingStore::destroy.
+struct StoreFactory {
+    BackingStore* (*make)(std::byte* buf, size_t size);
+
+    // whatever backend is configured process-wide, in the order remote, tiered, asynchronous file, file, shared memory, compressed, local memory
+    inline static constexpr StoreFactory automatic() noexcept;
+
+    inline static constexpr StoreFactory local_memory() noexcept;
+    inline static constexpr StoreFactory compressed() noexcept;
+    // the following throw std::system_error(ENXIO) when the backend has not been set up
+    inline static constexpr StoreFactory file() noexcept;
+    // falls back to FileStore when the file is open but io_uring is unavailable
+    inline static constexpr StoreFactory async_file() noexcept;
+    inline static constexpr StoreFactory tiered() noexcept;
+    inline static constexpr StoreFactory remote() noexcept;
+    inline static constexpr StoreFactory shared_memory() noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/store_factory.ipp>
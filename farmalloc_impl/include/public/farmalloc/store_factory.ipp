@@ -0,0 +1,105 @@
+#pragma once
+
+#include <farmalloc/store_factory.hpp>
+
+#include <farmalloc/async_file_store.hpp>
+#include <farmalloc/backing_store.hpp>
+#include <farmalloc/compressed_store.hpp>
+#include <farmalloc/file_store.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/remote_store.hpp>
+#include <farmalloc/shared_memory_store.hpp>
+#include <farmalloc/tiered_store.hpp>
+
+#include <errno.h>  // ENXIO
+
+#include <cstddef>
+#include <memory>
+#include <system_error>
+
+
+namespace FarMalloc
+{
+
+constexpr StoreFactory StoreFactory::automatic() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        if (RemoteStore::is_connected()) {
+            return std::construct_at(reinterpret_cast<RemoteStore*>(buf), size);
+        } else if (TieredStore::is_enabled()) {
+            return std::construct_at(reinterpret_cast<TieredStore*>(buf), size);
+        } else if (AsyncFileStore::is_active()) {
+            return std::construct_at(reinterpret_cast<AsyncFileStore*>(buf), size);
+        } else if (FileStore::is_open()) {
+            return std::construct_at(reinterpret_cast<FileStore*>(buf), size);
+        } else if (SharedMemoryStore::is_open()) {
+            return std::construct_at(reinterpret_cast<SharedMemoryStore*>(buf), size);
+        } else if (CompressedStore::is_enabled()) {
+            return std::construct_at(reinterpret_cast<CompressedStore*>(buf), size);
+        } else {
+            return std::construct_at(reinterpret_cast<LocalMemoryStore*>(buf), size);
+        }
+    }};
+}
+
+constexpr StoreFactory StoreFactory::local_memory() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        return std::construct_at(reinterpret_cast<LocalMemoryStore*>(buf), size);
+    }};
+}
+constexpr StoreFactory StoreFactory::compressed() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        return std::construct_at(reinterpret_cast<CompressedStore*>(buf), size);
+    }};
+}
+constexpr StoreFactory StoreFactory::file() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        if (!FileStore::is_open()) [[unlikely]] {
+            throw std::system_error{ENXIO, std::generic_category(), "FileStore is not open"};
+        }
+        return std::construct_at(reinterpret_cast<FileStore*>(buf), size);
+    }};
+}
+constexpr StoreFactory StoreFactory::async_file() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        if (AsyncFileStore::is_active()) [[likely]] {
+            return std::construct_at(reinterpret_cast<AsyncFileStore*>(buf), size);
+        } else if (FileStore::is_open()) {  // opened without io_uring: the synchronous store on the same file
+            return std::construct_at(reinterpret_cast<FileStore*>(buf), size);
+        }
+        throw std::system_error{ENXIO, std::generic_category(), "AsyncFileStore is not open"};
+    }};
+}
+constexpr StoreFactory StoreFactory::tiered() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        if (!TieredStore::is_enabled()) [[unlikely]] {
+            throw std::system_error{ENXIO, std::generic_category(), "TieredStore is not enabled"};
+        }
+        return std::construct_at(reinterpret_cast<TieredStore*>(buf), size);
+    }};
+}
+constexpr StoreFactory StoreFactory::remote() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        if (!RemoteStore::is_connected()) [[unlikely]] {
+            throw std::system_error{ENXIO, std::generic_category(), "RemoteStore is not connected"};
+        }
+        return std::construct_at(reinterpret_cast<RemoteStore*>(buf), size);
+    }};
+}
+constexpr StoreFactory StoreFactory::shared_memory() noexcept
+{
+    return {[](std::byte* buf, size_t size) -> BackingStore* {
+        if (!SharedMemoryStore::is_open()) [[unlikely]] {
+            throw std::system_error{ENXIO, std::generic_category(), "SharedMemoryStore is not open"};
+        }
+        return std::construct_at(reinterpret_cast<SharedMemoryStore*>(buf), size);
+    }};
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+enum class ArenaKind : uint8_t {
+    swappable_plain,
+    per_page,
+    large,  // a large allocation of the swappable plain suballocator
+    hint,   // an arena of HintAllocator
+};
+inline constexpr size_t NArenaKinds = 4;
+
+
+inline constexpr size_t NLatencyBuckets = 40;  // bucket i counts latencies in [2^(i-1), 2^i) ns; the last one is open-ended
+
+struct StoreStatsSnapshot {
+    struct Direction {
+        uint64_t ops = 0;
+        uint64_t bytes = 0;
+        std::array<uint64_t, NLatencyBuckets> latency_hist{};
+
+        // upper bound (in ns) of the bucket containing the `q`-quantile; 0 if no operation was recorded
+        inline uint64_t latency_quantile(double q) const noexcept;
+    };
+    struct Kind {
+        uint64_t n_live_stores = 0;
+        Direction read, write;
+    };
+    std::array<Kind, NArenaKinds> by_kind{};
+
+    const Kind& operator[](ArenaKind kind) const noexcept { return by_kind[static_cast<size_t>(kind)]; }
+};
+
+
+// counters of one store; updated with relaxed atomics only
+struct StoreStats {
+    struct Direction {
+        std::atomic_uint64_t ops{0};
+        std::atomic_uint64_t bytes{0};
+        std::array<std::atomic_uint64_t, NLatencyBuckets> latency_hist{};
+
+        inline void record(size_t size, uint64_t latency_ns) noexcept;
+        inline void accumulate_into(StoreStatsSnapshot::Direction& acc) const noexcept;
+    };
+    Direction read, write;
+};
+
+
+// Decorator recording per-store transfer statistics; outermost, so that it sees the latency the pager sees.
+// Live stores are linked into a list for snapshots, and the counters of destroyed stores are folded into per-kind totals.
+struct InstrumentedStore : BackingStore {
+    static bool enabled;
+    static std::mutex list_mtx;
+    static InstrumentedStore list_head;
+    static std::array<StoreStats, NArenaKinds> retired;
+
+    BackingStore* inner;
+    ArenaKind kind;
+    StoreStats stats;
+    InstrumentedStore* prev;
+    InstrumentedStore* next;
+
+    inline InstrumentedStore() noexcept : inner{nullptr}, kind{}, prev{this}, next{this} {}  // list head
+    inline InstrumentedStore(BackingStore* inner, ArenaKind kind);
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override { inner->populate(src, size); }
+    inline void discard(off_t off, size_t size) noexcept override { inner->discard(off, size); }
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+
+    // stores of swappable arenas created afterwards are instrumented
+    inline static void enable() noexcept { enabled = true; }
+    inline static void disable() noexcept { enabled = false; }
+    inline static bool is_enabled() noexcept { return enabled; }
+
+    // aggregate the counters of every store, live or destroyed, by arena kind
+    inline static StoreStatsSnapshot snapshot() noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/store_stats.ipp>
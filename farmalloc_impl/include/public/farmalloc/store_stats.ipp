@@ -0,0 +1,115 @@
+#pragma once
+
+#include <farmalloc/store_stats.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+uint64_t StoreStatsSnapshot::Direction::latency_quantile(double q) const noexcept
+{
+    uint64_t total = 0;
+    for (const auto cnt : latency_hist) {
+        total += cnt;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const auto target = static_cast<uint64_t>(q * static_cast<double>(total - 1));
+    uint64_t acc = 0;
+    for (size_t bucket = 0; bucket < latency_hist.size(); bucket++) {
+        acc += latency_hist[bucket];
+        if (acc > target) {
+            return uint64_t{1} << bucket;
+        }
+    }
+    return uint64_t{1} << (latency_hist.size() - 1);
+}
+
+
+void StoreStats::Direction::record(size_t size, uint64_t latency_ns) noexcept
+{
+    ops.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+    const auto bucket = std::min(static_cast<size_t>(std::bit_width(latency_ns)), NLatencyBuckets - 1);
+    latency_hist[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+void StoreStats::Direction::accumulate_into(StoreStatsSnapshot::Direction& acc) const noexcept
+{
+    acc.ops += ops.load(std::memory_order_relaxed);
+    acc.bytes += bytes.load(std::memory_order_relaxed);
+    for (size_t bucket = 0; bucket < NLatencyBuckets; bucket++) {
+        acc.latency_hist[bucket] += latency_hist[bucket].load(std::memory_order_relaxed);
+    }
+}
+
+
+InstrumentedStore::InstrumentedStore(BackingStore* inner, ArenaKind kind) : inner{inner}, kind{kind}
+{
+    std::lock_guard lk{list_mtx};
+    prev = &list_head;
+    next = list_head.next;
+    next->prev = this;
+    list_head.next = this;
+}
+void InstrumentedStore::destroy(size_t size)
+{
+    {
+        std::lock_guard lk{list_mtx};
+        prev->next = next;
+        next->prev = prev;
+
+        auto& total = retired[static_cast<size_t>(kind)];
+        const auto fold = [](const StoreStats::Direction& from, StoreStats::Direction& to) {
+            to.ops.fetch_add(from.ops.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            to.bytes.fetch_add(from.bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < NLatencyBuckets; bucket++) {
+                to.latency_hist[bucket].fetch_add(from.latency_hist[bucket].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        };
+        fold(stats.read, total.read);
+        fold(stats.write, total.write);
+    }
+    inner->destroy(size);
+}
+
+ssize_t InstrumentedStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto res = inner->read_from_store(buf, size_in_bytes, off);
+    stats.read.record(size_in_bytes, static_cast<uint64_t>(std::chrono::nanoseconds{std::chrono::steady_clock::now() - start}.count()));
+    return res;
+}
+ssize_t InstrumentedStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto res = inner->write_to_store(buf, size_in_bytes, off);
+    stats.write.record(size_in_bytes, static_cast<uint64_t>(std::chrono::nanoseconds{std::chrono::steady_clock::now() - start}.count()));
+    return res;
+}
+
+StoreStatsSnapshot InstrumentedStore::snapshot() noexcept
+{
+    StoreStatsSnapshot res;
+    std::lock_guard lk{list_mtx};
+    for (size_t kind = 0; kind < NArenaKinds; kind++) {
+        retired[kind].read.accumulate_into(res.by_kind[kind].read);
+        retired[kind].write.accumulate_into(res.by_kind[kind].write);
+    }
+    for (auto* store = list_head.next; store != &list_head; store = store->next) {
+        auto& acc = res.by_kind[static_cast<size_t>(store->kind)];
+        acc.n_live_stores++;
+        store->stats.read.accumulate_into(acc.read);
+        store->stats.write.accumulate_into(acc.write);
+    }
+    return res;
+}
+
+}  // namespace FarMalloc
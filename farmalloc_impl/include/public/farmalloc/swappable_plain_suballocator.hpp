@@ -1,9 +1,13 @@
 #pragma once
 
 #include <farmalloc/collective_allocator_params.hpp>
+#include <farmalloc/far_memory_group.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/numa.hpp>
 #include <farmalloc/plain_suballoc.hpp>
 #include <farmalloc/plain_suballoc_page_metadata.hpp>
-#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/store_buffer.hpp>
+#include <farmalloc/store_factory.hpp>
 
 #include <cstddef>
 
@@ -11,19 +15,30 @@
 namespace FarMalloc
 {
 
-struct SwappablePlainArena : PlainSuballocatorArena<LocalMemoryStoreBuffer, SwappablePlainOffset> {
-    using Base = PlainSuballocatorArena<LocalMemoryStoreBuffer, SwappablePlainOffset>;
+struct SwappablePlainCustom;
+struct SwappablePlainArena : PlainSuballocatorArena<StoreBuffer, SwappablePlainOffset> {
+    using Base = PlainSuballocatorArena<StoreBuffer, SwappablePlainOffset>;
 
-    inline SwappablePlainArena(FreePageLink& link);
+    inline SwappablePlainArena(FreePageLink& link, const SwappablePlainCustom& custom);
     inline ~SwappablePlainArena();
 
-    inline static SwappablePlainArena& create(FreePageLink& link);
+    inline static SwappablePlainArena& create(FreePageLink& link, SwappablePlainCustom& custom);
     inline static SwappablePlainArena& from_inside_ptr(const void* ptr) noexcept;
+    inline StoreBuffer& store_buf() noexcept { return this->appendix; }
 };
 
 
 struct SwappablePlainCustom {
-    inline constexpr SwappablePlainCustom() noexcept = default;
+    FarMemoryGroup* group;
+    StoreFactory factory;
+    // the pager maps these regions page by page
+    inline static constexpr HugePageMode huge_pages = HugePageMode::none;
+    NumaPlacement numa;
+    inline static constexpr NumaTier numa_tier = NumaTier::swappable_plain;
+
+    inline constexpr SwappablePlainCustom(FarMemoryGroup& group = FarMemoryGroup::default_group, StoreFactory factory = StoreFactory::automatic(),
+                                          NumaPlacement numa = NumaPlacement::first_touch) noexcept
+        : group{&group}, factory{factory}, numa{numa} {}
     inline constexpr void check_capacity(size_t) noexcept {}
     inline constexpr void consume_capacity(size_t) noexcept {}
     inline constexpr void reclaim_capacity(size_t) noexcept {}
@@ -34,6 +49,9 @@ struct SwappablePlainCustom {
     inline constexpr size_t large_alloc_size(size_t size) noexcept;
     inline void postprocess_large_alloc(void* ptr, size_t size);
     inline void preprocess_large_dealloc(void* ptr, size_t size);
+    // free pages of an arena neither take memory nor get written back or read in
+    inline void discard_pages(void* ptr, size_t size) noexcept;
+    inline void reuse_pages(void* ptr, size_t size) noexcept;
 };
 using SwappablePlainSuballocatorImpl = PlainSuballocatorImplBase<SwappablePlainArena, SwappablePlainCustom>;
 
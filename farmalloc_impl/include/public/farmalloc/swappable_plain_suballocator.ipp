@@ -2,9 +2,11 @@
 
 #include <farmalloc/swappable_plain_suballocator.hpp>
 
-#include <farmalloc/page_size.hpp>
+#include <farmalloc/far_memory_group.hpp>
 #include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/page_size.hpp>
 #include <farmalloc/plain_suballoc_page_metadata.hpp>
+#include <farmalloc/store_buffer.hpp>
 
 #include <cstddef>
 #include <memory>
@@ -14,10 +16,22 @@
 namespace FarMalloc
 {
 
-SwappablePlainArena::SwappablePlainArena(FreePageLink& link) : Base(link)
+SwappablePlainArena::SwappablePlainArena(FreePageLink& link, const SwappablePlainCustom& custom) : Base(link)
 {
-    auto* const store = this->appendix.construct(Base::DataNPages * PageSize);
-    LocalMemoryStore::umap(reinterpret_cast<void*>(Base::page_idx2head_ptr(0)), Base::DataNPages * PageSize, store);
+    auto* const region = reinterpret_cast<void*>(Base::page_idx2head_ptr(0));
+    try {
+        auto* const store = this->appendix.construct(region, Base::DataNPages * PageSize, ArenaKind::swappable_plain, custom.factory);
+        try {
+            LocalMemoryStore::umap(region, Base::DataNPages * PageSize, store, *custom.group);
+        } catch (...) {
+            this->appendix.destroy(Base::DataNPages * PageSize);
+            throw;
+        }
+    } catch (...) {
+        // the base constructor has already linked the data pages into the free list
+        Base::metadata(0).free.link.remove_from_list();
+        throw;
+    }
 }
 SwappablePlainArena::~SwappablePlainArena()
 {
@@ -25,10 +39,15 @@ SwappablePlainArena::~SwappablePlainArena()
     this->appendix.destroy(Base::DataNPages * PageSize);
 }
 
-SwappablePlainArena& SwappablePlainArena::create(FreePageLink& link)
+SwappablePlainArena& SwappablePlainArena::create(FreePageLink& link, SwappablePlainCustom& custom)
 {
-    const auto arena_addr = allocate_memory();
-    return *new (arena_addr) SwappablePlainArena{link};
+    const auto arena_addr = allocate_memory(ArenaSize, custom);
+    try {
+        return *new (arena_addr) SwappablePlainArena{link, custom};
+    } catch (...) {
+        release_memory(arena_addr, ArenaSize, custom);
+        throw;
+    }
 }
 SwappablePlainArena& SwappablePlainArena::from_inside_ptr(const void* ptr) noexcept
 {
@@ -38,23 +57,37 @@ SwappablePlainArena& SwappablePlainArena::from_inside_ptr(const void* ptr) noexc
 
 constexpr size_t SwappablePlainCustom::large_alloc_size(size_t size) noexcept
 {
-    static_assert(alignof(LocalMemoryStore) <= SwappablePlainArena::ArenaAlignment);
-    return (size + alignof(LocalMemoryStore) - 1) / alignof(LocalMemoryStore) * alignof(LocalMemoryStore) + sizeof(LocalMemoryStore);
+    static_assert(alignof(StoreBuffer) <= SwappablePlainArena::ArenaAlignment);
+    return (size + alignof(StoreBuffer) - 1) / alignof(StoreBuffer) * alignof(StoreBuffer) + sizeof(StoreBuffer);
 }
 void SwappablePlainCustom::postprocess_large_alloc(void* ptr, size_t size)
 {
-    const auto store_addr = reinterpret_cast<uintptr_t>(ptr) + size - sizeof(LocalMemoryStore);
-    const auto umap_size = (size - sizeof(LocalMemoryStore)) / PageSize * PageSize;
-    auto* const store = std::construct_at(reinterpret_cast<LocalMemoryStore*>(store_addr), umap_size);
-    LocalMemoryStore::umap(ptr, umap_size, store);
+    const auto store_addr = reinterpret_cast<uintptr_t>(ptr) + size - sizeof(StoreBuffer);
+    const auto umap_size = (size - sizeof(StoreBuffer)) / PageSize * PageSize;
+    auto* const store_buf = std::construct_at(reinterpret_cast<StoreBuffer*>(store_addr));
+    auto* const store = store_buf->construct(ptr, umap_size, ArenaKind::large, factory);
+    try {
+        LocalMemoryStore::umap(ptr, umap_size, store, *group);
+    } catch (...) {
+        store_buf->destroy(umap_size);
+        throw;
+    }
 }
 void SwappablePlainCustom::preprocess_large_dealloc(void* ptr, size_t size)
 {
-    const auto store_addr = reinterpret_cast<uintptr_t>(ptr) + size - sizeof(LocalMemoryStore);
-    const auto umap_size = (size - sizeof(LocalMemoryStore)) / PageSize * PageSize;
-    auto* store = std::launder(reinterpret_cast<LocalMemoryStore*>(store_addr));
+    const auto store_addr = reinterpret_cast<uintptr_t>(ptr) + size - sizeof(StoreBuffer);
+    const auto umap_size = (size - sizeof(StoreBuffer)) / PageSize * PageSize;
+    auto* store_buf = std::launder(reinterpret_cast<StoreBuffer*>(store_addr));
     LocalMemoryStore::uunmap(ptr, umap_size);
-    store->destroy(umap_size);
+    store_buf->destroy(umap_size);
+}
+void SwappablePlainCustom::discard_pages(void* ptr, size_t size) noexcept
+{
+    SwappablePlainArena::from_inside_ptr(ptr).store_buf().discard(ptr, size);
+}
+void SwappablePlainCustom::reuse_pages(void* ptr, size_t size) noexcept
+{
+    SwappablePlainArena::from_inside_ptr(ptr).store_buf().reuse(ptr, size);
 }
 
 }  // namespace FarMalloc
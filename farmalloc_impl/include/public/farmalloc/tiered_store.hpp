@@ -0,0 +1,82 @@
+#pragma once
+
+#include <farmalloc/file_store.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/numa.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <sys/types.h>  // off_t
+#include <sys/uio.h>    // iovec
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+// Keeps the far copy of each page in a bounded process-wide DRAM pool and spills the coldest pages
+// to the region's extent of the FileStore file when the pool is full; a spilled page is promoted back when it is read.
+// Pool frames are reclaimed in CLOCK order: a frame read or written since the hand last passed gets a second chance.
+// All-zero pages take neither a frame nor file space.
+// File I/O runs outside pool_mtx: a spilled frame is copied out and marked `spilling` so no one else picks it,
+// and every write or discard bumps the page's generation so that I/O racing with it is detected after relocking.
+struct TieredStore : FileStore {
+    struct Frame {
+        TieredStore* owner;  // nullptr when free
+        uint32_t page_idx;
+        bool referenced;
+        bool spilling;  // being written to the file outside pool_mtx; not reused until that finishes
+    };
+    // page_tab values other than frame indices
+    inline static constexpr uint32_t Zero = ~uint32_t{0}, Spilled = ~uint32_t{0} - 1;
+
+    static bool enabled;
+    static std::mutex pool_mtx;
+    static std::byte* pool_data;
+    static std::vector<Frame> frames;
+    static std::vector<uint32_t> free_frames;
+    static size_t clock_hand;
+    static std::condition_variable io_done;
+
+    static std::atomic_uint64_t n_spilled;
+    static std::atomic_uint64_t n_promoted;
+    static std::atomic_uint64_t failed_spills;
+
+    uint32_t* page_tab;
+    uint32_t* page_gen;  // bumped on each write or discard of the page
+    size_t n_in_flight = 0;  // file I/O on this store's extent outside pool_mtx
+
+    inline TieredStore(size_t size);
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    // page by page into the pool rather than FileStore's single pwritev
+    inline ssize_t write_vectored(const iovec* iov, int iovcnt, off_t off) noexcept override { return BackingStore::write_vectored(iov, iovcnt, off); }
+
+    // every swappable arena created afterwards keeps its pages in a pool of `pool_size` bytes, spilling to the FileStore file,
+    // which must be open until the last of these arenas is gone; the pool is set up by the first call, backed and placed as `huge` and `numa` say,
+    // and kept afterwards
+    inline static void enable(size_t pool_size, HugePageMode huge = HugePageMode::none, NumaPlacement numa = NumaPlacement::first_touch);
+    inline static void disable() noexcept { enabled = false; }
+    inline static bool is_enabled() noexcept { return enabled; }
+
+private:
+    inline bool load_page(size_t page_idx, std::byte* dst) noexcept;
+    inline bool store_page(size_t page_idx, const std::byte* src) noexcept;
+    inline void release_frame(size_t page_idx) noexcept;
+    inline static std::byte* frame_data(uint32_t frame) noexcept { return pool_data + size_t{frame} * PageSize; }
+    // may drop and retake `lk` to spill a victim, so the caller must re-check its page afterwards
+    inline static bool allocate_frame(std::unique_lock<std::mutex>& lk, uint32_t& frame) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/tiered_store.ipp>
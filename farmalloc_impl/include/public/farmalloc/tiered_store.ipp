@@ -0,0 +1,290 @@
+#pragma once
+
+#include <farmalloc/tiered_store.hpp>
+
+#include <farmalloc/aligned_mmap.hpp>
+#include <farmalloc/file_store.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/local_memory_store.hpp>
+#include <farmalloc/numa.hpp>
+#include <farmalloc/page_size.hpp>
+
+#include <errno.h>     // ENOMEM, ENXIO
+#include <sys/mman.h>  // mmap
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <system_error>
+
+
+namespace FarMalloc
+{
+
+TieredStore::TieredStore(size_t size) : FileStore{size}
+{
+    assert(size % PageSize == 0);
+    try {
+        page_tab = new uint32_t[size / PageSize];
+        page_gen = new uint32_t[size / PageSize]{};
+    } catch (...) {
+        delete[] page_tab;
+        FileStore::destroy(size);
+        throw;
+    }
+    std::fill_n(page_tab, size / PageSize, Zero);
+}
+void TieredStore::destroy(size_t size)
+{
+    {
+        std::unique_lock lk{pool_mtx};
+        io_done.wait(lk, [this] { return n_in_flight == 0; });
+        for (size_t page_idx = 0; page_idx < size / PageSize; page_idx++) {
+            release_frame(page_idx);
+        }
+    }
+    delete[] page_gen;
+    delete[] page_tab;
+    FileStore::destroy(size);
+}
+void TieredStore::populate(const std::byte* src, size_t size)
+{
+    for (size_t page_idx = 0; page_idx < size / PageSize; page_idx++) {
+        if (!store_page(page_idx, src + page_idx * PageSize)) [[unlikely]] {
+            throw std::system_error{errno, std::generic_category(), "pwrite"};
+        }
+    }
+}
+void TieredStore::discard(off_t off, size_t size) noexcept
+{
+    assert(off % PageSize == 0 && size % PageSize == 0);
+    {
+        std::lock_guard lk{pool_mtx};
+        const auto first = static_cast<size_t>(off) / PageSize;
+        for (size_t page_idx = first; page_idx < first + size / PageSize; page_idx++) {
+            release_frame(page_idx);
+            page_gen[page_idx]++;
+        }
+    }
+    FileStore::discard(off, size);
+}
+
+ssize_t TieredStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(off % PageSize == 0 && size_in_bytes % PageSize == 0);
+    LocalMemoryStore::read_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t i = 0; i < size_in_bytes / PageSize; i++) {
+        if (!load_page(first + i, reinterpret_cast<std::byte*>(buf) + i * PageSize)) [[unlikely]] {
+            return -1;
+        }
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+ssize_t TieredStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    assert(off % PageSize == 0 && size_in_bytes % PageSize == 0);
+    LocalMemoryStore::write_cnt.fetch_add(1, std::memory_order_relaxed);
+    const auto first = static_cast<size_t>(off) / PageSize;
+    for (size_t i = 0; i < size_in_bytes / PageSize; i++) {
+        if (!store_page(first + i, reinterpret_cast<const std::byte*>(buf) + i * PageSize)) [[unlikely]] {
+            return -1;
+        }
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+
+
+void TieredStore::enable(size_t pool_size, HugePageMode huge, NumaPlacement numa)
+{
+    if (!FileStore::is_open()) [[unlikely]] {
+        throw std::system_error{ENXIO, std::generic_category(), "FileStore is not open"};
+    }
+    std::lock_guard lk{pool_mtx};
+    if (pool_data == nullptr) {
+        const auto n_frames = std::min<size_t>(pool_size / PageSize, Spilled);
+        const auto pool_bytes = std::max<size_t>(n_frames, 1) * PageSize;
+        const auto mmap_result = huge != HugePageMode::none
+                                     ? AlignedMMap<HugePageSize, 0>(pool_bytes, huge)
+                                     : mmap(NULL, pool_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mmap_result == MAP_FAILED) [[unlikely]] {
+            if (errno == ENOMEM) [[likely]] {
+                throw std::bad_alloc{};
+            }
+            throw std::system_error{errno, std::generic_category(), "mmap"};
+        }
+        frames.assign(n_frames, Frame{nullptr, 0, false, false});
+        free_frames.reserve(n_frames);  // release_frame must not allocate
+        for (auto frame = n_frames; frame-- > 0;) {
+            free_frames.push_back(static_cast<uint32_t>(frame));
+        }
+        clock_hand = 0;
+        Numa::adopt(mmap_result, HugePageExtent(pool_bytes, huge), NumaTier::backing, numa);
+        pool_data = static_cast<std::byte*>(mmap_result);
+    }
+    enabled = true;
+}
+
+
+bool TieredStore::load_page(size_t page_idx, std::byte* dst) noexcept
+{
+    std::unique_lock lk{pool_mtx};
+    for (;;) {
+        if (const auto slot = page_tab[page_idx]; slot == Zero) {
+            std::memset(dst, 0, PageSize);
+            return true;
+        } else if (slot != Spilled) {
+            frames[slot].referenced = true;
+            std::memcpy(dst, frame_data(slot), PageSize);
+            return true;
+        }
+        const auto gen = page_gen[page_idx];
+        n_in_flight++;
+        lk.unlock();
+        const auto res = pread_all(reinterpret_cast<char*>(dst), PageSize, base + static_cast<off_t>(page_idx * PageSize));
+        lk.lock();
+        if (--n_in_flight == 0) {
+            io_done.notify_all();
+        }
+        if (res == -1) [[unlikely]] {
+            return false;
+        }
+        if (page_gen[page_idx] == gen) {
+            break;
+        }
+        // rewritten or discarded meanwhile, so what was read may be stale
+    }
+    // promote; if no frame can be freed, the page just stays in the file
+    if (uint32_t frame; allocate_frame(lk, frame)) {
+        if (page_tab[page_idx] == Spilled) {
+            std::memcpy(frame_data(frame), dst, PageSize);
+            frames[frame] = {this, static_cast<uint32_t>(page_idx), true, false};
+            page_tab[page_idx] = frame;
+            n_promoted.fetch_add(1, std::memory_order_relaxed);
+        } else {  // rewritten or discarded while a victim was spilled
+            free_frames.push_back(frame);
+        }
+    }
+    return true;
+}
+bool TieredStore::store_page(size_t page_idx, const std::byte* src) noexcept
+{
+    static_assert(PageSize % sizeof(uint64_t) == 0);
+    uint64_t any = 0;
+    for (size_t pos = 0; pos < PageSize && any == 0; pos += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, src + pos, sizeof(word));
+        any |= word;
+    }
+
+    std::unique_lock lk{pool_mtx};
+    page_gen[page_idx]++;
+    if (any == 0) {
+        release_frame(page_idx);
+        return true;
+    }
+    auto slot = page_tab[page_idx];
+    if (slot == Zero || slot == Spilled) {
+        uint32_t frame;
+        if (!allocate_frame(lk, frame)) [[unlikely]] {  // the pool cannot take it: write through to the file
+            if (const auto cur = page_tab[page_idx]; cur != Zero && cur != Spilled) {
+                release_frame(page_idx);
+            }
+            n_in_flight++;
+            lk.unlock();
+            const auto res = pwrite_all(reinterpret_cast<const char*>(src), PageSize, base + static_cast<off_t>(page_idx * PageSize));
+            lk.lock();
+            if (--n_in_flight == 0) {
+                io_done.notify_all();
+            }
+            page_gen[page_idx]++;  // a read that overlapped the write must retry
+            if (res == -1) [[unlikely]] {
+                return false;
+            }
+            page_tab[page_idx] = Spilled;
+            return true;
+        }
+        if (slot = page_tab[page_idx]; slot == Zero || slot == Spilled) {
+            frames[frame] = {this, static_cast<uint32_t>(page_idx), false, false};
+            page_tab[page_idx] = slot = frame;
+        } else {  // given a frame by a racing write while a victim was spilled
+            free_frames.push_back(frame);
+        }
+    }
+    frames[slot].referenced = true;
+    std::memcpy(frame_data(slot), src, PageSize);
+    return true;
+}
+// called with pool_mtx held
+void TieredStore::release_frame(size_t page_idx) noexcept
+{
+    if (const auto slot = page_tab[page_idx]; slot != Zero && slot != Spilled) {
+        frames[slot].owner = nullptr;
+        if (!frames[slot].spilling) {  // otherwise the spilling thread takes the frame
+            free_frames.push_back(slot);
+        }
+    }
+    page_tab[page_idx] = Zero;
+}
+// called with pool_mtx held; spills the first frame the CLOCK hand finds unreferenced
+bool TieredStore::allocate_frame(std::unique_lock<std::mutex>& lk, uint32_t& frame) noexcept
+{
+    alignas(PageSize) static thread_local std::byte spill_buf[PageSize];
+
+    // two sweeps clear every reference bit, so a third only meets frames whose spill failed
+    for (size_t n_visited = 0; n_visited < frames.size() * 3; n_visited++) {
+        if (!free_frames.empty()) {
+            frame = free_frames.back();
+            free_frames.pop_back();
+            return true;
+        }
+        const auto victim = clock_hand;
+        clock_hand = (clock_hand + 1) % frames.size();
+        auto& f = frames[victim];
+        if (f.owner == nullptr || f.spilling) {
+            continue;
+        }
+        if (f.referenced) {
+            f.referenced = false;
+            continue;
+        }
+        // write a copy outside the lock; the owner's destroy waits for it
+        auto* const owner = f.owner;
+        const auto page_idx = f.page_idx;
+        const auto gen = owner->page_gen[page_idx];
+        std::memcpy(spill_buf, frame_data(static_cast<uint32_t>(victim)), PageSize);
+        f.spilling = true;
+        owner->n_in_flight++;
+        lk.unlock();
+        const auto res = pwrite_all(reinterpret_cast<const char*>(spill_buf), PageSize, owner->base + static_cast<off_t>(size_t{page_idx} * PageSize));
+        lk.lock();
+        f.spilling = false;
+        if (--owner->n_in_flight == 0) {
+            io_done.notify_all();
+        }
+        if (f.owner == nullptr) {  // discarded meanwhile, so the frame is free
+            frame = static_cast<uint32_t>(victim);
+            return true;
+        }
+        if (res == -1) [[unlikely]] {
+            failed_spills.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (owner->page_gen[page_idx] != gen) {  // rewritten meanwhile, so the file copy is stale
+            continue;
+        }
+        owner->page_tab[page_idx] = Spilled;
+        f.owner = nullptr;
+        n_spilled.fetch_add(1, std::memory_order_relaxed);
+        frame = static_cast<uint32_t>(victim);
+        return true;
+    }
+    return false;
+}
+
+}  // namespace FarMalloc
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+// In-tree pager on userfaultfd(2), used instead of Umap when built with FARMALLOC_PAGER=uffd.
+// Mapped ranges are registered for missing and write-protect faults on one process-wide userfaultfd served by handler threads.
+// A missing fault reads the faulting page and up to `fill_batch - 1` following absent pages from the store in one call
+// and installs them write-protected with a single UFFDIO_COPY; the first write to a page then takes a write-protect fault that marks it dirty.
+// Resident pages are capped by `buffer_size` over all ranges: beyond it, pages are evicted in fill order,
+// passing over a page once for each level of its eviction priority, and written back only if dirty.
+// Pages at `Pinned` priority are never evicted, so the buffer may overflow while they fill it.
+// A fault whose page cannot be read is retried, its thread waking to fault again after a pause, and a page that cannot
+// be written back stays resident, overflowing the buffer; both are counted in `n_failed`, so a failing store stalls
+// the threads that need it instead of losing data or ending the process.
+// Needs write-protect support for anonymous memory (Linux 5.7) and, unless running privileged, vm.unprivileged_userfaultfd.
+struct UffdPager {
+    struct Config {
+        unsigned n_handlers = 2;
+        size_t buffer_size = size_t{1} << 30;  // bytes of resident pages over all ranges
+        size_t fill_batch = 8;  // pages
+    };
+
+    struct Range {
+        std::byte* ptr;
+        size_t n_pages;
+        BackingStore* store;
+        std::mutex mtx;  // held while pages of the range are filled, evicted or written back
+        bool dead = false;  // set under `mtx` by unmap, which leaves the pages local; a range found dead is left alone
+        std::unique_ptr<std::atomic_uint8_t[]> state;  // PageState bits per page; changed under `mtx`, read by prefetch without it
+        std::unique_ptr<uint8_t[]> priority;  // eviction priority per page
+        std::unique_ptr<uint8_t[]> chances;  // passes of the eviction hand left before the page goes
+    };
+    enum PageState : uint8_t {
+        resident = 1,
+        dirty = 2,
+    };
+    static constexpr uint8_t Pinned = UINT8_MAX;
+
+    static Config config;
+    static std::once_flag started;
+    static int uffd;
+    static int wake_fd;  // eventfd kicking the handlers when prefetches are queued
+
+    static std::shared_mutex ranges_mtx;
+    static std::map<uintptr_t, std::unique_ptr<Range>> ranges;  // by end address
+    static std::atomic_uint64_t ranges_gen;  // bumped by every map and unmap
+
+    static std::mutex fifo_mtx;
+    static std::deque<uintptr_t> fifo;  // addresses of filled pages, oldest first; stale entries are skipped
+    static std::atomic_size_t n_resident;
+
+    static std::mutex prefetch_mtx;
+    static std::vector<uintptr_t> prefetch_queue;
+
+    static std::atomic_uint64_t n_faults;
+    static std::atomic_uint64_t n_write_faults;
+    static std::atomic_uint64_t n_filled;
+    static std::atomic_uint64_t n_evicted;
+    static std::atomic_uint64_t n_written_back;
+    static std::atomic_uint64_t n_failed;  // faults, writebacks and evictions whose store or ioctl failed
+    static std::atomic_int last_error;  // errno of the latest failure
+
+    // takes effect if called before the first range is mapped
+    inline static void configure(const Config& config) noexcept { UffdPager::config = config; }
+
+    // [ptr, ptr + size) must be anonymous memory or hold nothing the store lacks, as it is then replaced by anonymous memory
+    inline static void map(void* ptr, size_t size, BackingStore* store);
+    // fills every absent page of the range before unregistering it
+    inline static void unmap(void* ptr, size_t size);
+    // queue the pages for the handlers, which fetch them only while the buffer has room
+    inline static void prefetch(uintptr_t page, uintptr_t end) noexcept;
+
+    // hook for containers: pages of [ptr, ptr + size) in a mapped range survive `priority` extra passes of the eviction hand
+    // a page shared by several objects keeps the highest priority asked for it until 0 resets it
+    inline static void set_priority(void* ptr, size_t size, uint8_t priority) noexcept;
+    // hook for containers: write back the resident pages of [ptr, ptr + size) in a mapped range if dirty and evict them now,
+    // dropping their priority
+    inline static void release(void* ptr, size_t size);
+
+private:
+    inline static void start();
+    inline static void handle_faults();
+
+    // call with `ranges_mtx` held; nullptr if `addr` is in no range
+    inline static Range* find(uintptr_t addr) noexcept;
+    // install up to `max_pages` absent pages from `first`, stopping at a resident one; returns how many were filled
+    inline static size_t fill(Range& range, size_t first, size_t max_pages, bool write_protect);
+    // in pages
+    inline static size_t capacity() noexcept;
+    // evict until `n_pages` more fit in the buffer
+    inline static void make_room(size_t n_pages);
+    // call with `range.mtx` held, for a resident page
+    inline static void evict(Range& range, size_t idx);
+    // a prefetch fills only while the buffer has room
+    inline static void fill_at(uintptr_t addr, bool prefetch);
+    inline static void write_fault(uintptr_t addr);
+    inline static void wake(uintptr_t addr, size_t len) noexcept;
+    inline static void record_failure(const std::exception_ptr& failure) noexcept;
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/uffd_pager.ipp>
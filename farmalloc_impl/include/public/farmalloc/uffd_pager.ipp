@@ -0,0 +1,506 @@
+#pragma once
+
+#include <farmalloc/uffd_pager.hpp>
+
+#include <farmalloc/page_size.hpp>
+
+#include <errno.h>              // errno, E*
+#include <fcntl.h>              // O_*
+#include <linux/userfaultfd.h>  // UFFD*, uffdio_*, uffd_msg
+#include <poll.h>               // poll
+#include <sys/eventfd.h>        // eventfd
+#include <sys/ioctl.h>          // ioctl
+#include <sys/mman.h>           // madvise, mmap
+#include <sys/syscall.h>        // SYS_userfaultfd
+#include <unistd.h>             // close, read, syscall, write
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <shared_mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+void UffdPager::start()
+{
+    const int fd = static_cast<int>(syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK));
+    if (fd == -1) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "userfaultfd"};
+    }
+    uffdio_api api{.api = UFFD_API, .features = UFFD_FEATURE_PAGEFAULT_FLAG_WP, .ioctls = 0};
+    if (ioctl(fd, UFFDIO_API, &api) != 0) [[unlikely]] {
+        const int err = errno;
+        close(fd);
+        throw std::system_error{err, std::generic_category(), "UFFDIO_API"};
+    }
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd == -1) [[unlikely]] {
+        const int err = errno;
+        close(fd);
+        throw std::system_error{err, std::generic_category(), "eventfd"};
+    }
+    uffd = fd;
+    // the handlers live as long as the process, as the ranges they serve may
+    for (unsigned i = 0; i < std::max(config.n_handlers, 1u); i++) {
+        std::thread{handle_faults}.detach();
+    }
+}
+
+void UffdPager::handle_faults()
+{
+    std::array<pollfd, 2> fds{pollfd{.fd = uffd, .events = POLLIN, .revents = 0}, pollfd{.fd = wake_fd, .events = POLLIN, .revents = 0}};
+    std::array<uffd_msg, 16> msgs;
+    std::vector<uintptr_t> prefetches;
+    while (true) {
+        if (poll(fds.data(), fds.size(), -1) <= 0) {
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            uint64_t cnt;
+            if (read(wake_fd, &cnt, sizeof(cnt)) == sizeof(cnt)) {
+                {
+                    std::lock_guard lock{prefetch_mtx};
+                    prefetches.swap(prefetch_queue);
+                }
+                for (const auto addr : prefetches) {
+                    try {
+                        fill_at(addr, true);
+                    } catch (...) {
+                        // a hint: nobody waits for it
+                    }
+                }
+                prefetches.clear();
+            }
+        }
+        // other handlers may have taken the messages
+        const auto n_bytes = read(uffd, msgs.data(), sizeof(msgs));
+        if (n_bytes <= 0) {
+            continue;
+        }
+        for (size_t i = 0; i < static_cast<size_t>(n_bytes) / sizeof(uffd_msg); i++) {
+            if (msgs[i].event != UFFD_EVENT_PAGEFAULT) {
+                continue;
+            }
+            const auto addr = static_cast<uintptr_t>(msgs[i].arg.pagefault.address) / PageSize * PageSize;
+            n_faults.fetch_add(1, std::memory_order_relaxed);
+            try {
+                if (msgs[i].arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP) {
+                    write_fault(addr);
+                } else {
+                    fill_at(addr, false);
+                }
+            } catch (...) {
+                // the fault is still unresolved: the woken thread faults again, which retries it
+                record_failure(std::current_exception());
+                std::this_thread::sleep_for(std::chrono::milliseconds{1});
+                wake(addr, PageSize);
+            }
+        }
+    }
+}
+
+
+UffdPager::Range* UffdPager::find(uintptr_t addr) noexcept
+{
+    const auto it = ranges.upper_bound(addr);
+    if (it == ranges.end() || addr < reinterpret_cast<uintptr_t>(it->second->ptr)) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+void UffdPager::wake(uintptr_t addr, size_t len) noexcept
+{
+    uffdio_range range{.start = addr, .len = len};
+    ioctl(uffd, UFFDIO_WAKE, &range);  // fails only if the range is gone, which wakes its waiters anyway
+}
+void UffdPager::record_failure(const std::exception_ptr& failure) noexcept
+{
+    int err = EIO;
+    try {
+        std::rethrow_exception(failure);
+    } catch (const std::system_error& e) {
+        err = e.code().value();
+    } catch (const std::bad_alloc&) {
+        err = ENOMEM;
+    } catch (...) {
+    }
+    last_error.store(err, std::memory_order_relaxed);
+    n_failed.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t UffdPager::fill(Range& range, size_t first, size_t max_pages, bool write_protect)
+{
+    size_t n_pages = 0;
+    while (n_pages < max_pages && !(range.state[first + n_pages] & resident)) {
+        n_pages++;
+    }
+    if (n_pages == 0) {
+        return 0;
+    }
+    thread_local std::vector<std::byte> staging;
+    staging.resize(n_pages * PageSize);
+    const auto off = static_cast<off_t>(first * PageSize);
+    if (range.store->read_from_store(reinterpret_cast<char*>(staging.data()), n_pages * PageSize, off) != static_cast<ssize_t>(n_pages * PageSize)) [[unlikely]] {
+        throw std::system_error{EIO, std::generic_category(), "read_from_store"};
+    }
+
+    // counted before the copy wakes the faulting thread, whose next fault must find room made for them
+    n_resident.fetch_add(n_pages, std::memory_order_relaxed);
+    n_filled.fetch_add(n_pages, std::memory_order_relaxed);
+    const auto uncount = [&] {
+        n_resident.fetch_sub(n_pages, std::memory_order_relaxed);
+        n_filled.fetch_sub(n_pages, std::memory_order_relaxed);
+    };
+    const auto copy = [&](size_t idx, size_t n) {
+        uffdio_copy args{
+            .dst = reinterpret_cast<uintptr_t>(range.ptr) + (first + idx) * PageSize,
+            .src = reinterpret_cast<uintptr_t>(staging.data()) + idx * PageSize,
+            .len = n * PageSize,
+            .mode = write_protect ? UFFDIO_COPY_MODE_WP : 0,
+            .copy = 0,
+        };
+        return ioctl(uffd, UFFDIO_COPY, &args) == 0 ? 0 : errno;
+    };
+    if (const int err = copy(0, n_pages); err == EEXIST) {
+        // some pages were present before the range was mapped: they are kept, and assumed dirty as their writes went unseen
+        for (size_t idx = 0; idx < n_pages; idx++) {
+            if (const int page_err = copy(idx, 1); page_err == EEXIST) {
+                range.state[first + idx] = dirty;
+            } else if (page_err != 0) [[unlikely]] {
+                // those copied so far are taken up as dirty by a later fill, like pages present before the mapping
+                uncount();
+                throw std::system_error{page_err, std::generic_category(), "UFFDIO_COPY"};
+            }
+        }
+    } else if (err != 0) [[unlikely]] {
+        uncount();
+        throw std::system_error{err, std::generic_category(), "UFFDIO_COPY"};
+    }
+
+    for (size_t idx = first; idx < first + n_pages; idx++) {
+        range.state[idx] |= resident;
+        range.chances[idx] = range.priority[idx];
+    }
+    return n_pages;
+}
+
+size_t UffdPager::capacity() noexcept
+{
+    return std::max(config.buffer_size / PageSize, config.fill_batch);
+}
+
+void UffdPager::make_room(size_t n_pages)
+{
+    size_t n_pinned_passed = 0;
+    while (n_resident.load(std::memory_order_relaxed) + n_pages > capacity()) {
+        uintptr_t addr;
+        {
+            std::lock_guard lock{fifo_mtx};
+            if (fifo.empty() || n_pinned_passed > fifo.size()) {
+                return;  // the rest is being filled right now, or pinned
+            }
+            addr = fifo.front();
+            fifo.pop_front();
+        }
+        std::shared_lock lock{ranges_mtx};
+        auto* const range = find(addr);
+        if (range == nullptr) {
+            continue;
+        }
+        std::lock_guard range_lock{range->mtx};
+        const auto idx = (addr - reinterpret_cast<uintptr_t>(range->ptr)) / PageSize;
+        if (range->dead || !(range->state[idx] & resident)) {
+            continue;
+        }
+        if (range->priority[idx] == Pinned) {
+            n_pinned_passed++;
+            std::lock_guard fifo_lock{fifo_mtx};
+            fifo.push_back(addr);
+            continue;
+        }
+        n_pinned_passed = 0;
+        if (range->chances[idx] > 0) {
+            range->chances[idx]--;
+            std::lock_guard fifo_lock{fifo_mtx};
+            fifo.push_back(addr);
+            continue;
+        }
+        try {
+            evict(*range, idx);
+        } catch (...) {
+            // the page stays resident, so it stays in line
+            std::lock_guard fifo_lock{fifo_mtx};
+            fifo.push_back(addr);
+            throw;
+        }
+    }
+}
+
+void UffdPager::evict(Range& range, size_t idx)
+{
+    const auto addr = reinterpret_cast<uintptr_t>(range.ptr) + idx * PageSize;
+    if (range.state[idx] & dirty) {
+        // protect the page first, so that a write racing with the writeback waits for the eviction instead of being lost
+        uffdio_writeprotect protect{.range = {.start = addr, .len = PageSize}, .mode = UFFDIO_WRITEPROTECT_MODE_WP};
+        if (ioctl(uffd, UFFDIO_WRITEPROTECT, &protect) != 0) [[unlikely]] {
+            throw std::system_error{errno, std::generic_category(), "UFFDIO_WRITEPROTECT"};
+        }
+        if (range.store->write_to_store(reinterpret_cast<char*>(addr), PageSize, static_cast<off_t>(idx * PageSize)) != static_cast<ssize_t>(PageSize)) [[unlikely]] {
+            throw std::system_error{EIO, std::generic_category(), "write_to_store"};
+        }
+        n_written_back.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (madvise(reinterpret_cast<void*>(addr), PageSize, MADV_DONTNEED) != 0) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "madvise(MADV_DONTNEED)"};
+    }
+    range.state[idx] = 0;
+    n_resident.fetch_sub(1, std::memory_order_relaxed);
+    n_evicted.fetch_add(1, std::memory_order_relaxed);
+}
+
+void UffdPager::fill_at(uintptr_t addr, bool prefetch)
+{
+    if (!prefetch) {
+        try {
+            make_room(config.fill_batch);
+        } catch (...) {
+            // a page that cannot be written back must not hold up the fault: the buffer overflows instead
+            record_failure(std::current_exception());
+        }
+    } else if (n_resident.load(std::memory_order_relaxed) + config.fill_batch > capacity()) {
+        return;  // a hint never evicts
+    }
+    std::shared_lock lock{ranges_mtx};
+    auto* const range = find(addr);
+    if (range == nullptr) {
+        wake(addr, PageSize);  // unmapped meanwhile
+        return;
+    }
+    const auto first = (addr - reinterpret_cast<uintptr_t>(range->ptr)) / PageSize;
+    size_t n_pages;
+    {
+        std::lock_guard range_lock{range->mtx};
+        if (range->dead) {
+            wake(addr, PageSize);
+            return;
+        }
+        // filled meanwhile if none: the fill woke the faulting thread
+        n_pages = fill(*range, first, std::min(config.fill_batch, range->n_pages - first), true);
+    }
+    std::lock_guard fifo_lock{fifo_mtx};
+    for (size_t idx = 0; idx < n_pages; idx++) {
+        fifo.push_back(addr + idx * PageSize);
+    }
+}
+
+void UffdPager::write_fault(uintptr_t addr)
+{
+    n_write_faults.fetch_add(1, std::memory_order_relaxed);
+    std::shared_lock lock{ranges_mtx};
+    auto* const range = find(addr);
+    if (range == nullptr) {
+        wake(addr, PageSize);
+        return;
+    }
+    std::lock_guard range_lock{range->mtx};
+    auto& state = range->state[(addr - reinterpret_cast<uintptr_t>(range->ptr)) / PageSize];
+    if (range->dead || !(state & resident)) {
+        wake(addr, PageSize);  // evicted meanwhile: the write faults again as missing
+        return;
+    }
+    state |= dirty;
+    // lifting the protection wakes the writer
+    uffdio_writeprotect unprotect{.range = {.start = addr, .len = PageSize}, .mode = 0};
+    if (ioctl(uffd, UFFDIO_WRITEPROTECT, &unprotect) != 0) [[unlikely]] {
+        throw std::system_error{errno, std::generic_category(), "UFFDIO_WRITEPROTECT"};
+    }
+}
+
+
+void UffdPager::map(void* ptr, size_t size, BackingStore* store)
+{
+    std::call_once(started, start);
+    const auto n_pages = size / PageSize;
+    auto range = std::make_unique<Range>();
+    range->ptr = static_cast<std::byte*>(ptr);
+    range->n_pages = n_pages;
+    range->store = store;
+    range->state = std::make_unique<std::atomic_uint8_t[]>(n_pages);
+    range->priority = std::make_unique<uint8_t[]>(n_pages);
+    range->chances = std::make_unique<uint8_t[]>(n_pages);
+    const auto key = reinterpret_cast<uintptr_t>(ptr) + size;
+    {
+        std::unique_lock lock{ranges_mtx};
+        ranges.emplace(key, std::move(range));
+        ranges_gen.fetch_add(1, std::memory_order_release);
+    }
+    uffdio_register args{
+        .range = {.start = reinterpret_cast<uintptr_t>(ptr), .len = size},
+        .mode = UFFDIO_REGISTER_MODE_MISSING | UFFDIO_REGISTER_MODE_WP,
+        .ioctls = 0,
+    };
+    int res = ioctl(uffd, UFFDIO_REGISTER, &args);
+    if (res != 0 && errno == EINVAL) {
+        // not anonymous memory, e.g. an arena restored from a checkpoint file: the store holds its contents, so it is replaced
+        if (mmap(ptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            res = ioctl(uffd, UFFDIO_REGISTER, &args);
+        }
+    }
+    if (res != 0) [[unlikely]] {
+        const int err = errno;
+        std::unique_lock lock{ranges_mtx};
+        ranges.erase(key);
+        ranges_gen.fetch_add(1, std::memory_order_release);
+        throw std::system_error{err, std::generic_category(), "UFFDIO_REGISTER"};
+    }
+}
+
+void UffdPager::unmap(void* ptr, size_t size)
+{
+    constexpr size_t Chunk = 64;  // pages filled per UFFDIO_COPY
+    const auto key = reinterpret_cast<uintptr_t>(ptr) + size;
+    Range* range;
+    {
+        std::shared_lock lock{ranges_mtx};
+        range = find(reinterpret_cast<uintptr_t>(ptr));
+    }
+    if (range == nullptr) [[unlikely]] {
+        return;
+    }
+    {
+        std::lock_guard range_lock{range->mtx};
+        for (size_t page = 0; page < range->n_pages;) {
+            const auto n_pages = fill(*range, page, std::min(Chunk, range->n_pages - page), false);
+            page += std::max(n_pages, size_t{1});
+        }
+        uffdio_writeprotect unprotect{.range = {.start = reinterpret_cast<uintptr_t>(ptr), .len = size}, .mode = 0};
+        uffdio_range whole{.start = reinterpret_cast<uintptr_t>(ptr), .len = size};
+        if (ioctl(uffd, UFFDIO_WRITEPROTECT, &unprotect) != 0 || ioctl(uffd, UFFDIO_UNREGISTER, &whole) != 0) [[unlikely]] {
+            throw std::system_error{errno, std::generic_category(), "UFFDIO_UNREGISTER"};
+        }
+        n_resident.fetch_sub(range->n_pages, std::memory_order_relaxed);
+        // handlers may already hold the range and wait for `mtx`
+        range->dead = true;
+    }
+    std::unique_lock lock{ranges_mtx};
+    ranges.erase(key);
+    ranges_gen.fetch_add(1, std::memory_order_release);
+}
+
+void UffdPager::prefetch(uintptr_t page, uintptr_t end) noexcept
+{
+    constexpr size_t MaxQueued = 4096;
+    if (n_resident.load(std::memory_order_relaxed) + config.fill_batch > capacity()) {
+        return;  // nothing would be filled
+    }
+    // hints come in bursts on the same range, which is looked up again only once the ranges change
+    thread_local struct {
+        uint64_t gen = ~uint64_t{0};
+        uintptr_t begin = 0, end = 0;
+        Range* range = nullptr;
+    } last;
+    std::shared_lock lock{ranges_mtx};
+    if (const auto gen = ranges_gen.load(std::memory_order_relaxed); gen != last.gen || page < last.begin || last.end <= page) {
+        auto* const range = find(page);
+        if (range == nullptr) {
+            return;
+        }
+        const auto begin = reinterpret_cast<uintptr_t>(range->ptr);
+        last = {.gen = gen, .begin = begin, .end = begin + range->n_pages * PageSize, .range = range};
+    }
+
+    std::array<uintptr_t, 16> absent;
+    size_t n_absent = 0;
+    for (; page < std::min(end, last.end) && n_absent < absent.size(); page += PageSize) {
+        if (!(last.range->state[(page - last.begin) / PageSize].load(std::memory_order_relaxed) & resident)) {
+            absent[n_absent++] = page;
+        }
+    }
+    lock.unlock();
+    if (n_absent == 0) {
+        return;
+    }
+    bool was_empty;
+    {
+        std::lock_guard lock{prefetch_mtx};
+        was_empty = prefetch_queue.empty();
+        if (prefetch_queue.size() + n_absent > MaxQueued) {
+            return;
+        }
+        prefetch_queue.insert(prefetch_queue.end(), absent.begin(), absent.begin() + static_cast<ptrdiff_t>(n_absent));
+    }
+    // the handler that takes the queue takes all of it
+    if (was_empty) {
+        const uint64_t one = 1;
+        [[maybe_unused]] const auto res = write(wake_fd, &one, sizeof(one));
+    }
+}
+
+void UffdPager::set_priority(void* ptr, size_t size, uint8_t priority) noexcept
+{
+    auto addr = reinterpret_cast<uintptr_t>(ptr) / PageSize * PageSize;
+    const auto end = reinterpret_cast<uintptr_t>(ptr) + size;
+    std::shared_lock lock{ranges_mtx};
+    while (addr < end) {
+        auto* const range = find(addr);
+        if (range == nullptr) {
+            return;
+        }
+        const auto range_begin = reinterpret_cast<uintptr_t>(range->ptr);
+        const auto range_end = range_begin + range->n_pages * PageSize;
+        std::lock_guard range_lock{range->mtx};
+        if (range->dead) {
+            return;
+        }
+        for (; addr < std::min(end, range_end); addr += PageSize) {
+            const auto idx = (addr - range_begin) / PageSize;
+            if (priority == 0) {
+                range->priority[idx] = range->chances[idx] = 0;
+            } else {
+                range->priority[idx] = std::max(range->priority[idx], priority);
+                range->chances[idx] = std::max(range->chances[idx], priority);
+            }
+        }
+    }
+}
+
+void UffdPager::release(void* ptr, size_t size)
+{
+    auto addr = reinterpret_cast<uintptr_t>(ptr) / PageSize * PageSize;
+    const auto end = reinterpret_cast<uintptr_t>(ptr) + size;
+    std::shared_lock lock{ranges_mtx};
+    while (addr < end) {
+        auto* const range = find(addr);
+        if (range == nullptr) {
+            return;
+        }
+        const auto range_begin = reinterpret_cast<uintptr_t>(range->ptr);
+        const auto range_end = range_begin + range->n_pages * PageSize;
+        std::lock_guard range_lock{range->mtx};
+        if (range->dead) {
+            return;
+        }
+        // the pages' entries stay in `fifo`, to be skipped, or to hasten the next eviction of a page filled again meanwhile
+        for (; addr < std::min(end, range_end); addr += PageSize) {
+            const auto idx = (addr - range_begin) / PageSize;
+            range->priority[idx] = range->chances[idx] = 0;
+            if (range->state[idx] & resident) {
+                evict(*range, idx);
+            }
+        }
+    }
+}
+
+}  // namespace FarMalloc
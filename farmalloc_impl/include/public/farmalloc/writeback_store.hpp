@@ -0,0 +1,100 @@
+#pragma once
+
+#include <farmalloc/backing_store.hpp>
+
+#include <sys/types.h>  // off_t
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+namespace FarMalloc
+{
+
+struct WritebackConfig {
+    size_t max_bytes = size_t{4} << 20;     // flush a store once this much is staged in it
+    std::chrono::milliseconds max_age{50};  // ... or once its oldest staged page has waited this long
+    size_t max_total_bytes = size_t{64} << 20;  // over all stores; a write that would pass it flushes its store, or goes through
+};
+
+// Decorator that stages the writebacks of one region instead of passing them on page by page.
+// Staged pages serve reads and absorb rewrites; a flush sorts them by offset and hands every run of adjacent pages
+// to the wrapped store as a single vectored write (see BackingStore::write_vectored).
+// A store is flushed when it holds `max_bytes`, when its oldest page gets `max_age` old
+// (checked on writes and by a background thread while enabled), and on `flush`/`sync`.
+// A page the wrapped store fails to take stays staged, counted in `failed_writes`, and is retried by the next flush;
+// until then a read overlapping it fails rather than return the older contents.
+struct WritebackStore : BackingStore {
+    using Clock = std::chrono::steady_clock;
+
+    struct Staged {
+        char* buf;
+        size_t size;
+    };
+
+    // pages gathered into one vectored write at most
+    inline static constexpr int MaxRunLength = 64;
+
+    static std::atomic_bool enabled;
+    static WritebackConfig config;  // for the stores created afterwards; guarded by instances_mtx
+
+    static std::mutex instances_mtx;
+    static WritebackStore* instances;  // every live WritebackStore, linked through prev/next
+    static std::condition_variable_any flusher_cv;
+    static std::jthread flusher;
+
+    static std::atomic_size_t total_staged_bytes;  // over all stores, against WritebackConfig::max_total_bytes
+
+    static std::atomic_uint64_t n_staged;
+    static std::atomic_uint64_t n_absorbed;  // rewrites of a page that was still staged
+    static std::atomic_uint64_t n_runs;      // vectored writes issued by flushes
+    static std::atomic_uint64_t failed_writes;
+
+    BackingStore* inner;
+    WritebackConfig limits;  // `config` when this store was created
+
+    std::mutex mtx;
+    std::map<off_t, Staged> staged;
+    size_t staged_bytes = 0;
+    Clock::time_point oldest;  // when the first of the staged pages was written
+
+    WritebackStore *prev = nullptr, *next = nullptr;
+
+    inline explicit WritebackStore(BackingStore* inner) noexcept;
+    inline ~WritebackStore();
+    inline void destroy(size_t size) override;
+    inline void populate(const std::byte* src, size_t size) override;
+    inline void discard(off_t off, size_t size) noexcept override;
+
+    inline ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+    inline ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept override;
+
+    // write every staged page of this store through; whether all of them went
+    inline bool flush() noexcept;
+
+    // every swappable arena created afterwards has its store wrapped; starts the background flusher
+    inline static void enable(const WritebackConfig& cfg = {});
+    // arenas created afterwards are not wrapped, and the existing wrappers write through from now on
+    inline static void disable() noexcept;
+    inline static bool is_enabled() noexcept { return enabled.load(std::memory_order_relaxed); }
+    // flush every store, e.g. before the backing file is inspected or copied
+    inline static bool sync() noexcept;
+
+private:
+    inline bool overlaps_staged(off_t off, size_t size) const noexcept;
+    inline bool flush_locked() noexcept;
+    // free a staged page; the one after it
+    inline std::map<off_t, Staged>::iterator unstage(std::map<off_t, Staged>::iterator it) noexcept;
+    inline void discard_locked() noexcept;
+    inline static void flush_loop(std::stop_token stop);
+};
+
+}  // namespace FarMalloc
+
+#include <farmalloc/writeback_store.ipp>
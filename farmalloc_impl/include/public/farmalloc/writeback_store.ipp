@@ -0,0 +1,257 @@
+#pragma once
+
+#include <farmalloc/writeback_store.hpp>
+
+#include <farmalloc/page_size.hpp>
+
+#include <sys/uio.h>  // iovec
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+namespace FarMalloc
+{
+
+WritebackStore::WritebackStore(BackingStore* inner) noexcept : inner{inner}
+{
+    std::lock_guard lock{instances_mtx};
+    limits = config;
+    next = instances;
+    if (next != nullptr) {
+        next->prev = this;
+    }
+    instances = this;
+}
+WritebackStore::~WritebackStore()
+{
+    {
+        std::lock_guard lock{instances_mtx};
+        (prev != nullptr ? prev->next : instances) = next;
+        if (next != nullptr) {
+            next->prev = prev;
+        }
+    }
+    discard_locked();
+}
+void WritebackStore::destroy(size_t size)
+{
+    {
+        std::lock_guard lock{mtx};
+        discard_locked();  // the region is gone; nobody will read the pages again
+    }
+    inner->destroy(size);
+}
+void WritebackStore::populate(const std::byte* src, size_t size)
+{
+    {
+        std::lock_guard lock{mtx};
+        discard_locked();  // stale writebacks must not overtake the new contents
+    }
+    inner->populate(src, size);
+}
+
+void WritebackStore::discard(off_t off, size_t size) noexcept
+{
+    {
+        std::lock_guard lock{mtx};
+        const auto last = staged.lower_bound(off + static_cast<off_t>(size));
+        for (auto it = staged.lower_bound(off); it != last;) {
+            it = unstage(it);
+        }
+    }
+    inner->discard(off, size);
+}
+
+ssize_t WritebackStore::read_from_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    {
+        std::lock_guard lock{mtx};
+        if (const auto it = staged.find(off); it != staged.end() && it->second.size == size_in_bytes) {
+            std::memcpy(buf, it->second.buf, size_in_bytes);
+            return static_cast<ssize_t>(size_in_bytes);
+        }
+        if (overlaps_staged(off, size_in_bytes)) [[unlikely]] {
+            if (!flush_locked() && overlaps_staged(off, size_in_bytes)) {
+                return -1;  // the wrapped store holds older contents
+            }
+        }
+    }
+    return inner->read_from_store(buf, size_in_bytes, off);
+}
+ssize_t WritebackStore::write_to_store(char* buf, size_t size_in_bytes, off_t off) noexcept
+{
+    std::lock_guard lock{mtx};
+    if (const auto it = staged.find(off); it != staged.end() && it->second.size == size_in_bytes) {
+        std::memcpy(it->second.buf, buf, size_in_bytes);
+        n_absorbed.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<ssize_t>(size_in_bytes);
+    }
+    const bool write_through = !enabled.load(std::memory_order_relaxed);
+    if (write_through || overlaps_staged(off, size_in_bytes)) [[unlikely]] {
+        if (!flush_locked() && overlaps_staged(off, size_in_bytes)) {
+            return -1;  // the older page would overwrite this one when it goes through
+        }
+        if (write_through) {
+            return inner->write_to_store(buf, size_in_bytes, off);
+        }
+    }
+    if (total_staged_bytes.load(std::memory_order_relaxed) + size_in_bytes > limits.max_total_bytes) [[unlikely]] {
+        flush_locked();
+        if (total_staged_bytes.load(std::memory_order_relaxed) + size_in_bytes > limits.max_total_bytes) {
+            return inner->write_to_store(buf, size_in_bytes, off);
+        }
+    }
+
+    const auto staging_size = (size_in_bytes + PageSize - 1) / PageSize * PageSize;
+    auto* const staging = static_cast<char*>(std::aligned_alloc(PageSize, staging_size));
+    if (staging == nullptr) [[unlikely]] {
+        return inner->write_to_store(buf, size_in_bytes, off);
+    }
+    std::memcpy(staging, buf, size_in_bytes);
+    try {
+        staged.emplace(off, Staged{staging, size_in_bytes});
+    } catch (...) {
+        std::free(staging);
+        return inner->write_to_store(buf, size_in_bytes, off);
+    }
+    const auto now = Clock::now();
+    if (staged_bytes == 0) {
+        oldest = now;
+    }
+    staged_bytes += size_in_bytes;
+    total_staged_bytes.fetch_add(size_in_bytes, std::memory_order_relaxed);
+    n_staged.fetch_add(1, std::memory_order_relaxed);
+
+    if (staged_bytes >= limits.max_bytes || now - oldest >= limits.max_age) {
+        flush_locked();
+    }
+    return static_cast<ssize_t>(size_in_bytes);
+}
+
+bool WritebackStore::flush() noexcept
+{
+    std::lock_guard lock{mtx};
+    return flush_locked();
+}
+
+
+void WritebackStore::enable(const WritebackConfig& cfg)
+{
+    disable();
+    {
+        std::lock_guard lock{instances_mtx};
+        config = cfg;
+    }
+    enabled.store(true, std::memory_order_relaxed);
+    flusher = std::jthread{flush_loop};
+}
+void WritebackStore::disable() noexcept
+{
+    enabled.store(false, std::memory_order_relaxed);
+    if (flusher.joinable()) {
+        flusher.request_stop();
+        flusher.join();
+    }
+    sync();
+}
+bool WritebackStore::sync() noexcept
+{
+    std::lock_guard lock{instances_mtx};
+    bool all_written = true;
+    for (auto* store = instances; store != nullptr; store = store->next) {
+        all_written &= store->flush();
+    }
+    return all_written;
+}
+
+
+bool WritebackStore::overlaps_staged(off_t off, size_t size) const noexcept
+{
+    auto it = staged.lower_bound(off);
+    if (it != staged.end() && it->first < off + static_cast<off_t>(size)) {
+        return true;
+    }
+    return it != staged.begin() && std::prev(it)->first + static_cast<off_t>(std::prev(it)->second.size) > off;
+}
+
+bool WritebackStore::flush_locked() noexcept
+{
+    std::array<iovec, MaxRunLength> iov;
+    bool all_written = true;
+    for (auto it = staged.begin(); it != staged.end();) {
+        // gather the run of adjacent pages starting at `it`
+        const auto run_begin = it;
+        const auto run_off = it->first;
+        auto run_end = run_off;
+        int n = 0;
+        for (; it != staged.end() && it->first == run_end && n < MaxRunLength; ++it, ++n) {
+            iov[static_cast<size_t>(n)] = {it->second.buf, it->second.size};
+            run_end += static_cast<off_t>(it->second.size);
+        }
+
+        n_runs.fetch_add(1, std::memory_order_relaxed);
+        if (inner->write_vectored(iov.data(), n, run_off) == run_end - run_off) [[likely]] {
+            for (auto page = run_begin; page != it;) {
+                page = unstage(page);
+            }
+            continue;
+        }
+        // retry page by page, so that one bad page does not hold up its neighbors; it stays staged for the next flush
+        for (auto page = run_begin; page != it;) {
+            if (inner->write_to_store(page->second.buf, page->second.size, page->first) == static_cast<ssize_t>(page->second.size)) {
+                page = unstage(page);
+            } else {
+                failed_writes.fetch_add(1, std::memory_order_relaxed);
+                all_written = false;
+                ++page;
+            }
+        }
+    }
+    if (!all_written) {
+        oldest = Clock::now();  // retried once it has waited max_age again
+    }
+    return all_written;
+}
+void WritebackStore::discard_locked() noexcept
+{
+    for (auto& [off, page] : staged) {
+        std::free(page.buf);
+    }
+    staged.clear();
+    total_staged_bytes.fetch_sub(staged_bytes, std::memory_order_relaxed);
+    staged_bytes = 0;
+}
+auto WritebackStore::unstage(std::map<off_t, Staged>::iterator it) noexcept -> std::map<off_t, Staged>::iterator
+{
+    staged_bytes -= it->second.size;
+    total_staged_bytes.fetch_sub(it->second.size, std::memory_order_relaxed);
+    std::free(it->second.buf);
+    return staged.erase(it);
+}
+
+void WritebackStore::flush_loop(std::stop_token stop)
+{
+    std::unique_lock lock{instances_mtx};
+    while (!stop.stop_requested()) {
+        flusher_cv.wait_for(lock, stop, config.max_age / 2, [] { return false; });
+        const auto now = Clock::now();
+        for (auto* store = instances; store != nullptr; store = store->next) {
+            std::lock_guard store_lock{store->mtx};
+            if (store->staged_bytes != 0 && now - store->oldest >= store->limits.max_age) {
+                store->flush_locked();
+            }
+        }
+    }
+}
+
+}  // namespace FarMalloc
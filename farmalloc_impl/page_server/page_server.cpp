@@ -0,0 +1,149 @@
+// Stand-in for a remote memory node: serves the page reads and writes of RemoteStore from its own DRAM.
+//   usage: farmalloc_page_server [unix:PATH | [HOST:]PORT]
+
+#include <farmalloc/page_server_protocol.hpp>
+
+#include <errno.h>       // errno, E*
+#include <sys/mman.h>    // mmap, munmap
+#include <sys/socket.h>  // accept
+#include <unistd.h>      // close
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace
+{
+
+using namespace FarMalloc::PageServerProtocol;
+
+struct Region {
+    std::byte* data;
+    size_t size;
+};
+
+// one thread per client; its regions live as long as the connection
+void serve(int fd)
+{
+    std::unordered_map<uint64_t, Region> regions;
+    uint64_t next_region = 0;
+    auto reader = std::make_unique<BufferedReader>(fd);
+    std::vector<std::byte> out;
+
+    const auto respond = [&](uint64_t tag, int64_t status, const std::byte* payload, size_t payload_size) {
+        const ResponseHeader header{.tag = tag, .status = status};
+        const auto header_ptr = reinterpret_cast<const std::byte*>(&header);
+        out.insert(out.end(), header_ptr, header_ptr + sizeof(header));
+        out.insert(out.end(), payload, payload + payload_size);
+    };
+    const auto lookup = [&](const RequestHeader& req) -> Region* {
+        const auto it = regions.find(req.region);
+        if (it == regions.end() || req.offset > it->second.size || req.size > it->second.size - req.offset) {
+            return nullptr;
+        }
+        return &it->second;
+    };
+
+    // return false when the connection is broken
+    const auto handle = [&](const RequestHeader& req) {
+        switch (req.op) {
+        case Op::alloc: {
+            const auto mmap_result = mmap(NULL, req.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (mmap_result == MAP_FAILED) {
+                respond(req.tag, -errno, nullptr, 0);
+                return true;
+            }
+            regions.emplace(next_region, Region{static_cast<std::byte*>(mmap_result), req.size});
+            respond(req.tag, static_cast<int64_t>(next_region++), nullptr, 0);
+            return true;
+        }
+        case Op::free:
+            if (const auto it = regions.find(req.region); it != regions.end()) {
+                munmap(it->second.data, it->second.size);
+                regions.erase(it);
+                respond(req.tag, 0, nullptr, 0);
+            } else {
+                respond(req.tag, -EINVAL, nullptr, 0);
+            }
+            return true;
+        case Op::read:
+            if (const auto region = lookup(req); region != nullptr) {
+                respond(req.tag, static_cast<int64_t>(req.size), region->data + req.offset, req.size);
+            } else {
+                respond(req.tag, -EINVAL, nullptr, 0);
+            }
+            return true;
+        case Op::write:
+            if (const auto region = lookup(req); region != nullptr) {
+                if (!reader->read_exact(region->data + req.offset, req.size)) {
+                    return false;
+                }
+                respond(req.tag, static_cast<int64_t>(req.size), nullptr, 0);
+            } else {
+                std::byte sink[4096];
+                for (size_t left = req.size; left != 0;) {  // skip the payload
+                    const auto n = std::min(left, sizeof(sink));
+                    if (!reader->read_exact(sink, n)) {
+                        return false;
+                    }
+                    left -= n;
+                }
+                respond(req.tag, -EINVAL, nullptr, 0);
+            }
+            return true;
+        default:
+            return false;
+        }
+    };
+
+    for (RequestHeader req; reader->read_exact(&req, sizeof(req)) && handle(req);) {
+        // answer in batches: send only when no further request is already buffered
+        if (reader->begin == reader->end) {
+            if (!send_all(fd, out.data(), out.size())) {
+                break;
+            }
+            out.clear();
+        }
+    }
+
+    for (auto& [id, region] : regions) {
+        munmap(region.data, region.size);
+    }
+    close(fd);
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv)
+{
+    const char* address = argc > 1 ? argv[1] : "unix:/tmp/farmalloc_page_server.sock";
+    int listen_fd;
+    try {
+        listen_fd = open_socket(address, true);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "farmalloc_page_server: %s: %s\n", address, e.what());
+        return 1;
+    }
+    std::fprintf(stderr, "farmalloc_page_server: listening on %s\n", address);
+
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::perror("farmalloc_page_server: accept");
+            return 1;
+        }
+        std::thread{serve, fd}.detach();
+    }
+}
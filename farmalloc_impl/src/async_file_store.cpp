@@ -0,0 +1,24 @@
+#include <farmalloc/async_file_store.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+IoUring AsyncFileStore::ring;
+std::mutex AsyncFileStore::ring_mtx;
+std::condition_variable AsyncFileStore::ring_cv;
+bool AsyncFileStore::reaping = false;
+size_t AsyncFileStore::n_in_flight = 0;
+unsigned AsyncFileStore::batch_size = 32;
+std::deque<AsyncFileStore::Request*> AsyncFileStore::queued;
+std::map<off_t, AsyncFileStore::Request*> AsyncFileStore::pending_writes;
+std::atomic_uint64_t AsyncFileStore::failed_writes = 0;
+
+}  // namespace FarMalloc
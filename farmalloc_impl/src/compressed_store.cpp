@@ -0,0 +1,22 @@
+#include <farmalloc/compressed_store.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+
+namespace FarMalloc
+{
+
+bool CompressedStore::enabled = false;
+std::mutex CompressedStore::pool_mtx;
+CompressedStore::Pool CompressedStore::pool;
+std::unordered_map<uint64_t, CompressedStore::Blob*> CompressedStore::dedup_tab;
+
+std::atomic_uint64_t CompressedStore::n_zero_pages = 0;
+std::atomic_uint64_t CompressedStore::n_shared_pages = 0;
+std::atomic_uint64_t CompressedStore::stored_bytes = 0;
+std::atomic_uint64_t CompressedStore::pool_bytes = 0;
+
+}  // namespace FarMalloc
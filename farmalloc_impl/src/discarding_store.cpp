@@ -0,0 +1,13 @@
+#include <farmalloc/discarding_store.hpp>
+
+#include <atomic>
+
+
+namespace FarMalloc
+{
+
+std::atomic_uint64_t DiscardingStore::n_discarded_pages = 0;
+std::atomic_uint64_t DiscardingStore::n_skipped_reads = 0;
+std::atomic_uint64_t DiscardingStore::n_skipped_writes = 0;
+
+}  // namespace FarMalloc
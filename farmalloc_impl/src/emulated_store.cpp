@@ -0,0 +1,20 @@
+#include <farmalloc/emulated_store.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+bool EmulatedStore::enabled = false;
+FabricModel EmulatedStore::model{};
+
+std::mutex EmulatedStore::queue_mtx;
+std::condition_variable EmulatedStore::queue_cv;
+unsigned EmulatedStore::n_in_flight = 0;
+std::atomic<EmulatedStore::Clock::rep> EmulatedStore::link_free_at = 0;
+std::atomic_uint64_t EmulatedStore::injected_ns = 0;
+
+}  // namespace FarMalloc
@@ -0,0 +1,13 @@
+#include <farmalloc/far_memory_group.hpp>
+
+#include <atomic>
+
+
+namespace FarMalloc
+{
+
+FarMemoryGroup FarMemoryGroup::default_group;
+std::atomic_size_t FarMemoryGroup::n_far_groups = 0;
+WorkerPool FarMemoryGroup::workers;
+
+}  // namespace FarMalloc
@@ -0,0 +1,21 @@
+#include <farmalloc/fault_trace.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+namespace FarMalloc
+{
+
+bool FaultTrace::enabled = false;
+std::unique_ptr<FaultTrace::Record[]> FaultTrace::ring;
+size_t FaultTrace::capacity = 0;
+std::atomic_uint64_t FaultTrace::n_appended = 0;
+std::atomic_uint32_t FaultTrace::n_arenas = 0;
+std::atomic_uint16_t FaultTrace::current_tag = 0;
+std::chrono::steady_clock::time_point FaultTrace::epoch;
+
+}  // namespace FarMalloc
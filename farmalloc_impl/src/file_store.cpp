@@ -0,0 +1,20 @@
+#include <farmalloc/file_store.hpp>
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+int FileStore::fd = -1;
+bool FileStore::direct_io = false;
+off_t FileStore::capacity = 0;
+
+std::mutex FileStore::extents_mtx;
+off_t FileStore::file_tail = 0;
+std::map<off_t, size_t> FileStore::free_extents;
+std::multimap<size_t, off_t> FileStore::free_sizes;
+
+}  // namespace FarMalloc
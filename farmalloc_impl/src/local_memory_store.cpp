@@ -1,5 +1,9 @@
 #include <farmalloc/local_memory_store.hpp>
 
+#include <farmalloc/arena_registry.hpp>
+#include <farmalloc/huge_pages.hpp>
+#include <farmalloc/numa.hpp>
+
 #include <atomic>
 
 
@@ -8,8 +12,9 @@ namespace FarMalloc
 
 std::atomic_uint64_t LocalMemoryStore::read_cnt = 0;
 std::atomic_uint64_t LocalMemoryStore::write_cnt = 0;
+std::atomic<HugePageMode> LocalMemoryStore::huge_pages = HugePageMode::none;
+std::atomic<NumaPlacement> LocalMemoryStore::numa = NumaPlacement::first_touch;
 
-LocalMemoryStore::MappingType LocalMemoryStore::mapping{0, &LocalMemoryStore::arena_ptr_hash};
-bool LocalMemoryStore::far_memory_mode = false;
+ArenaRegistry LocalMemoryStore::mapping;
 
 }  // namespace FarMalloc
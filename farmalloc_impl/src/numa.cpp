@@ -0,0 +1,15 @@
+#include <farmalloc/numa.hpp>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+bool Numa::tracking = false;
+std::mutex Numa::mappings_mtx;
+std::map<uintptr_t, Numa::Mapping> Numa::mappings;
+
+}  // namespace FarMalloc
@@ -0,0 +1,13 @@
+#include <farmalloc/plain_suballoc_thread_cache.hpp>
+
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+std::mutex PlainThreadCache::registry_mtx;
+thread_local PlainThreadCache::Local PlainThreadCache::local;
+thread_local bool PlainThreadCache::local_gone = false;
+
+}  // namespace FarMalloc
@@ -0,0 +1,16 @@
+#include <farmalloc/prefetching_store.hpp>
+
+#include <atomic>
+
+
+namespace FarMalloc
+{
+
+bool PrefetchingStore::enabled = false;
+PrefetchConfig PrefetchingStore::config{};
+
+std::atomic_uint64_t PrefetchingStore::n_prefetched_pages = 0;
+std::atomic_uint64_t PrefetchingStore::n_confirmed = 0;
+std::atomic_uint64_t PrefetchingStore::n_broken = 0;
+
+}  // namespace FarMalloc
@@ -0,0 +1,24 @@
+#include <farmalloc/remote_store.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+int RemoteStore::sock_fd = -1;
+std::mutex RemoteStore::send_mtx;
+std::vector<std::byte> RemoteStore::send_buf;
+size_t RemoteStore::batch_bytes = 0;
+uint64_t RemoteStore::next_tag = 0;
+
+std::mutex RemoteStore::pending_mtx;
+std::unordered_map<uint64_t, RemoteStore::Pending*> RemoteStore::pending;
+std::thread RemoteStore::receiver;
+
+}  // namespace FarMalloc
@@ -0,0 +1,11 @@
+#include <farmalloc/resident_budget.hpp>
+
+#include <atomic>
+
+
+namespace FarMalloc
+{
+
+std::atomic_size_t ResidentBudget::total_limit = 0;
+
+}  // namespace FarMalloc
@@ -0,0 +1,19 @@
+#include <farmalloc/shared_memory_store.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace FarMalloc
+{
+
+int SharedMemoryStore::fd = -1;
+size_t SharedMemoryStore::mapped_size = 0;
+SharedMemoryStore::Segment* SharedMemoryStore::segment = nullptr;
+std::atomic_uint32_t* SharedMemoryStore::next_slot = nullptr;
+std::atomic_uint16_t* SharedMemoryStore::slot_owner = nullptr;
+std::byte* SharedMemoryStore::slots = nullptr;
+uint32_t SharedMemoryStore::attachment = 0;
+
+}  // namespace FarMalloc
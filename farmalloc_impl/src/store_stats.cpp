@@ -0,0 +1,15 @@
+#include <farmalloc/store_stats.hpp>
+
+#include <array>
+#include <mutex>
+
+
+namespace FarMalloc
+{
+
+bool InstrumentedStore::enabled = false;
+std::mutex InstrumentedStore::list_mtx;
+InstrumentedStore InstrumentedStore::list_head;
+std::array<StoreStats, NArenaKinds> InstrumentedStore::retired;
+
+}  // namespace FarMalloc
@@ -0,0 +1,26 @@
+#include <farmalloc/tiered_store.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+bool TieredStore::enabled = false;
+std::mutex TieredStore::pool_mtx;
+std::byte* TieredStore::pool_data = nullptr;
+std::vector<TieredStore::Frame> TieredStore::frames;
+std::vector<uint32_t> TieredStore::free_frames;
+size_t TieredStore::clock_hand = 0;
+std::condition_variable TieredStore::io_done;
+
+std::atomic_uint64_t TieredStore::n_spilled = 0;
+std::atomic_uint64_t TieredStore::n_promoted = 0;
+std::atomic_uint64_t TieredStore::failed_spills = 0;
+
+}  // namespace FarMalloc
@@ -0,0 +1,41 @@
+#include <farmalloc/uffd_pager.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+
+namespace FarMalloc
+{
+
+UffdPager::Config UffdPager::config;
+std::once_flag UffdPager::started;
+int UffdPager::uffd = -1;
+int UffdPager::wake_fd = -1;
+
+std::shared_mutex UffdPager::ranges_mtx;
+std::map<uintptr_t, std::unique_ptr<UffdPager::Range>> UffdPager::ranges;
+std::atomic_uint64_t UffdPager::ranges_gen = 0;
+
+std::mutex UffdPager::fifo_mtx;
+std::deque<uintptr_t> UffdPager::fifo;
+std::atomic_size_t UffdPager::n_resident = 0;
+
+std::mutex UffdPager::prefetch_mtx;
+std::vector<uintptr_t> UffdPager::prefetch_queue;
+
+std::atomic_uint64_t UffdPager::n_faults = 0;
+std::atomic_uint64_t UffdPager::n_write_faults = 0;
+std::atomic_uint64_t UffdPager::n_filled = 0;
+std::atomic_uint64_t UffdPager::n_evicted = 0;
+std::atomic_uint64_t UffdPager::n_written_back = 0;
+std::atomic_uint64_t UffdPager::n_failed = 0;
+std::atomic_int UffdPager::last_error = 0;
+
+}  // namespace FarMalloc
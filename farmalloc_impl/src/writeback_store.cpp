@@ -0,0 +1,28 @@
+#include <farmalloc/writeback_store.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+
+namespace FarMalloc
+{
+
+std::atomic_bool WritebackStore::enabled = false;
+WritebackConfig WritebackStore::config{};
+
+std::mutex WritebackStore::instances_mtx;
+WritebackStore* WritebackStore::instances = nullptr;
+std::condition_variable_any WritebackStore::flusher_cv;
+std::jthread WritebackStore::flusher;
+
+std::atomic_size_t WritebackStore::total_staged_bytes = 0;
+
+std::atomic_uint64_t WritebackStore::n_staged = 0;
+std::atomic_uint64_t WritebackStore::n_absorbed = 0;
+std::atomic_uint64_t WritebackStore::n_runs = 0;
+std::atomic_uint64_t WritebackStore::failed_writes = 0;
+
+}  // namespace FarMalloc
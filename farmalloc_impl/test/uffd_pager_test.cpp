@@ -0,0 +1,161 @@
+// Round trip through UffdPager: pages fault in from a store, get evicted and written back under a small buffer,
+// survive failing store calls, and are all local and intact after unmap.
+// Exits with 77 (skipped) where userfaultfd is unavailable.
+
+#include <farmalloc/page_size.hpp>
+#include <farmalloc/uffd_pager.hpp>
+
+#include <sys/mman.h>  // mmap, munmap
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+
+namespace
+{
+
+using namespace FarMalloc;
+
+constexpr size_t NPages = 256;
+constexpr size_t BufferPages = 16;
+
+// keeps the pages in a vector; the next `n_failing_reads` reads and `n_failing_writes` writes fail
+struct VectorStore : BackingStore {
+    std::vector<std::byte> data = std::vector<std::byte>(NPages * PageSize);
+    std::atomic_int n_failing_reads = 0, n_failing_writes = 0;
+
+    void destroy(size_t) override {}
+    void populate(const std::byte* src, size_t size) override { std::memcpy(data.data(), src, size); }
+
+    ssize_t read_from_store(char* buf, size_t size_in_bytes, off_t off) override
+    {
+        if (n_failing_reads.load() > 0 && n_failing_reads.fetch_sub(1) > 0) {
+            return -1;
+        }
+        std::memcpy(buf, data.data() + off, size_in_bytes);
+        return static_cast<ssize_t>(size_in_bytes);
+    }
+    ssize_t write_to_store(char* buf, size_t size_in_bytes, off_t off) override
+    {
+        if (n_failing_writes.load() > 0 && n_failing_writes.fetch_sub(1) > 0) {
+            return -1;
+        }
+        std::memcpy(data.data() + off, buf, size_in_bytes);
+        return static_cast<ssize_t>(size_in_bytes);
+    }
+};
+
+int n_errors = 0;
+
+void check(bool ok, const char* what)
+{
+    if (!ok) {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        n_errors++;
+    }
+}
+
+uint64_t value_of(size_t page, size_t word, uint64_t round)
+{
+    return (page << 32) ^ (word << 8) ^ round;
+}
+
+// reads every page, checking that the words at its head and tail hold `round`
+bool all_pages_hold(const uint64_t* words, uint64_t round)
+{
+    constexpr size_t NWords = PageSize / sizeof(uint64_t);
+    for (size_t page = 0; page < NPages; page++) {
+        if (words[page * NWords] != value_of(page, 0, round) || words[page * NWords + NWords - 1] != value_of(page, NWords - 1, round)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void write_all_pages(uint64_t* words, uint64_t round)
+{
+    constexpr size_t NWords = PageSize / sizeof(uint64_t);
+    for (size_t page = 0; page < NPages; page++) {
+        words[page * NWords] = value_of(page, 0, round);
+        words[page * NWords + NWords - 1] = value_of(page, NWords - 1, round);
+    }
+}
+
+}  // namespace
+
+
+int main()
+{
+    constexpr size_t Size = NPages * PageSize;
+    UffdPager::configure({.n_handlers = 2, .buffer_size = BufferPages * PageSize, .fill_batch = 4});
+
+    auto* const ptr = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        std::perror("mmap");
+        return 1;
+    }
+    auto* const words = static_cast<uint64_t*>(ptr);
+    write_all_pages(words, 1);
+    VectorStore store;
+    store.populate(static_cast<std::byte*>(ptr), Size);
+    madvise(ptr, Size, MADV_DONTNEED);
+
+    try {
+        UffdPager::map(ptr, Size, &store);
+    } catch (const std::system_error& e) {
+        std::fprintf(stderr, "skipped: %s\n", e.what());
+        return 77;
+    }
+
+    // clean pages fault in and are dropped without writeback
+    check(all_pages_hold(words, 1), "pages read back from the store");
+    check(UffdPager::n_filled.load() >= NPages, "every page was filled");
+    check(UffdPager::n_evicted.load() > 0, "pages were evicted");
+    check(UffdPager::n_written_back.load() == 0, "clean pages are not written back");
+    check(UffdPager::n_resident.load() <= BufferPages, "the buffer holds");
+
+    // dirty pages are written back on eviction and read back
+    write_all_pages(words, 2);
+    check(UffdPager::n_written_back.load() > 0, "dirty pages were written back");
+    check(all_pages_hold(words, 2), "written pages read back");
+
+    // a failing store stalls the faulting thread until it recovers
+    const auto n_failed = UffdPager::n_failed.load();
+    store.n_failing_reads = 3;
+    store.n_failing_writes = 3;
+    write_all_pages(words, 3);
+    check(all_pages_hold(words, 3), "pages survive failing store calls");
+    check(UffdPager::n_failed.load() > n_failed, "the failures were counted");
+
+    // a pinned page is not evicted
+    UffdPager::set_priority(ptr, PageSize, UffdPager::Pinned);
+    check(all_pages_hold(words, 3), "pages read back after pinning");
+    const auto n_faults = UffdPager::n_faults.load();
+    check(words[0] == value_of(0, 0, 3), "the pinned page holds");
+    check(UffdPager::n_faults.load() == n_faults, "the pinned page stays resident");
+
+    // release writes a dirty page back and drops it
+    words[0] = value_of(0, 0, 4);
+    UffdPager::release(ptr, PageSize);
+    uint64_t in_store;
+    std::memcpy(&in_store, store.data.data(), sizeof(in_store));
+    check(in_store == value_of(0, 0, 4), "release writes back");
+    words[0] = value_of(0, 0, 3);
+
+    // unmap leaves every page local
+    UffdPager::unmap(ptr, Size);
+    check(UffdPager::n_resident.load() == 0, "nothing is resident after unmap");
+    store.n_failing_reads = 1000;
+    check(all_pages_hold(words, 3), "pages are local after unmap");
+
+    munmap(ptr, Size);
+    if (n_errors == 0) {
+        std::puts("ok");
+    }
+    return n_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+// Replays a trace written by FarMalloc::FaultTrace::dump against simulated local caches of the given sizes
+// under LRU, CLOCK and ARC, and reports how many of the traced page reads each one would have missed.
+//   usage: farmalloc_trace_sim [--by-tag] TRACE SIZE...
+// SIZE is in bytes, with an optional K, M or G suffix. Every page read of the trace is a reference; writebacks are not,
+// since the pager issues them on eviction. Pages that hit in the captured run never reach the store and are not in the trace,
+// so the replay is closest to the real reference stream when the capture ran with a small local buffer.
+
+#include <farmalloc/fault_trace_format.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace
+{
+
+using namespace FarMalloc::FaultTraceFormat;
+
+struct Reference {
+    uint64_t page;  // arena in the upper half
+    uint16_t tag;
+};
+
+
+struct Lru {
+    size_t capacity;
+    std::list<uint64_t> order;  // most recent first
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> where;
+
+    explicit Lru(size_t capacity) : capacity{capacity} {}
+
+    bool access(uint64_t page)
+    {
+        if (const auto it = where.find(page); it != where.end()) {
+            order.splice(order.begin(), order, it->second);
+            return true;
+        }
+        if (order.size() == capacity) {
+            where.erase(order.back());
+            order.pop_back();
+        }
+        order.push_front(page);
+        where.emplace(page, order.begin());
+        return false;
+    }
+};
+
+
+struct Clock {
+    struct Frame {
+        uint64_t page;
+        bool referenced;
+    };
+    size_t capacity;
+    std::vector<Frame> frames;
+    std::unordered_map<uint64_t, size_t> where;
+    size_t hand = 0;
+
+    explicit Clock(size_t capacity) : capacity{capacity} {}
+
+    bool access(uint64_t page)
+    {
+        if (const auto it = where.find(page); it != where.end()) {
+            frames[it->second].referenced = true;
+            return true;
+        }
+        if (frames.size() < capacity) {
+            where.emplace(page, frames.size());
+            frames.push_back({page, false});
+            return false;
+        }
+        while (frames[hand].referenced) {
+            frames[hand].referenced = false;
+            hand = (hand + 1) % capacity;
+        }
+        where.erase(frames[hand].page);
+        frames[hand] = {page, false};
+        where.emplace(page, hand);
+        hand = (hand + 1) % capacity;
+        return false;
+    }
+};
+
+
+// Adaptive Replacement Cache (Megiddo and Modha, FAST 2003): t1 and t2 hold the cached pages seen once and more than once,
+// b1 and b2 the ghosts recently evicted from them, which steer the target size `p` of t1
+struct Arc {
+    enum ListId : uint8_t { t1, t2, b1, b2 };
+    struct Entry {
+        ListId list;
+        std::list<uint64_t>::iterator it;
+    };
+    size_t capacity;
+    size_t p = 0;
+    std::list<uint64_t> lists[4];  // most recent first
+    std::unordered_map<uint64_t, Entry> where;
+
+    explicit Arc(size_t capacity) : capacity{capacity} {}
+
+    void move_to_front(Entry& entry, ListId to)
+    {
+        lists[to].splice(lists[to].begin(), lists[entry.list], entry.it);
+        entry.list = to;
+    }
+    void drop_lru(ListId from)
+    {
+        where.erase(lists[from].back());
+        lists[from].pop_back();
+    }
+    // evict the LRU page of t1 or t2 into its ghost list
+    void replace(bool in_b2)
+    {
+        const auto t1_size = lists[t1].size();
+        const auto victim_list = t1_size > 0 && (t1_size > p || (in_b2 && t1_size == p)) ? t1 : t2;
+        const auto victim = lists[victim_list].back();
+        move_to_front(where.at(victim), victim_list == t1 ? b1 : b2);
+    }
+
+    bool access(uint64_t page)
+    {
+        if (const auto it = where.find(page); it != where.end()) {
+            auto& entry = it->second;
+            switch (entry.list) {
+            case t1:
+            case t2:
+                move_to_front(entry, t2);
+                return true;
+            case b1:
+                p = std::min(capacity, p + std::max<size_t>(lists[b2].size() / lists[b1].size(), 1));
+                replace(false);
+                move_to_front(entry, t2);
+                return false;
+            case b2:
+                p -= std::min(p, std::max<size_t>(lists[b1].size() / lists[b2].size(), 1));
+                replace(true);
+                move_to_front(entry, t2);
+                return false;
+            default:
+                return false;
+            }
+        }
+        const auto l1 = lists[t1].size() + lists[b1].size(),
+                   total = l1 + lists[t2].size() + lists[b2].size();
+        if (l1 == capacity) {
+            if (lists[t1].size() < capacity) {
+                drop_lru(b1);
+                replace(false);
+            } else {
+                drop_lru(t1);
+            }
+        } else if (total >= capacity) {
+            if (total == 2 * capacity) {
+                drop_lru(b2);
+            }
+            replace(false);
+        }
+        lists[t1].push_front(page);
+        where.emplace(page, Entry{t1, lists[t1].begin()});
+        return false;
+    }
+};
+
+
+struct Result {
+    uint64_t misses = 0;
+    std::map<uint16_t, uint64_t> misses_by_tag;
+};
+
+template <class Policy>
+Result replay(const std::vector<Reference>& refs, size_t n_pages)
+{
+    Policy cache{n_pages};
+    Result res;
+    for (const auto& ref : refs) {
+        if (!cache.access(ref.page)) {
+            res.misses++;
+            res.misses_by_tag[ref.tag]++;
+        }
+    }
+    return res;
+}
+
+
+size_t parse_size(const std::string& arg)
+{
+    size_t pos;
+    auto size = std::stoull(arg, &pos);
+    if (pos + 1 == arg.size()) {
+        switch (arg[pos]) {
+        case 'K':
+        case 'k':
+            return size << 10;
+        case 'M':
+        case 'm':
+            return size << 20;
+        case 'G':
+        case 'g':
+            return size << 30;
+        default:
+            break;
+        }
+    }
+    if (pos != arg.size()) {
+        throw std::invalid_argument{"bad size " + arg};
+    }
+    return size;
+}
+
+}  // namespace
+
+
+int main(int argc, char** argv)
+{
+    int argi = 1;
+    const bool by_tag = argi < argc && std::string{argv[argi]} == "--by-tag";
+    argi += by_tag;
+    if (argc - argi < 2) {
+        std::fprintf(stderr, "usage: %s [--by-tag] TRACE SIZE...\n", argv[0]);
+        return 2;
+    }
+
+    std::FILE* file = std::fopen(argv[argi], "rb");
+    if (file == nullptr) {
+        std::perror(argv[argi]);
+        return 1;
+    }
+    Header header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 || header.magic != Magic || header.record_size != sizeof(Record)) {
+        std::fprintf(stderr, "farmalloc_trace_sim: %s: not a fault trace\n", argv[argi]);
+        return 1;
+    }
+    std::vector<Record> records(header.n_records);
+    if (std::fread(records.data(), sizeof(Record), records.size(), file) != records.size()) {
+        std::fprintf(stderr, "farmalloc_trace_sim: %s: truncated\n", argv[argi]);
+        return 1;
+    }
+    std::fclose(file);
+
+    std::vector<Reference> refs;
+    std::map<uint16_t, uint64_t> refs_by_tag;
+    uint64_t n_written = 0;
+    for (const auto& rec : records) {
+        if (rec.op == Op::write) {
+            n_written += rec.n_pages;
+            continue;
+        }
+        for (uint32_t i = 0; i < rec.n_pages; i++) {
+            refs.push_back({uint64_t{rec.arena} << 32 | (rec.page + i), rec.tag});
+        }
+        refs_by_tag[rec.tag] += rec.n_pages;
+    }
+    std::unordered_set<uint64_t> distinct;
+    for (const auto& ref : refs) {
+        distinct.insert(ref.page);
+    }
+    std::printf("%llu records (%llu lost), %zu page reads of %zu distinct pages, %llu page writes, %u-byte pages\n",
+        static_cast<unsigned long long>(header.n_records), static_cast<unsigned long long>(header.n_lost),
+        refs.size(), distinct.size(), static_cast<unsigned long long>(n_written), header.page_size);
+
+    std::printf("%14s %6s %12s %8s\n", "size", "policy", "misses", "ratio");
+    for (argi++; argi < argc; argi++) {
+        size_t n_pages;
+        try {
+            n_pages = std::max<size_t>(parse_size(argv[argi]) / header.page_size, 1);
+        } catch (const std::exception&) {
+            std::fprintf(stderr, "farmalloc_trace_sim: bad size %s\n", argv[argi]);
+            return 2;
+        }
+        const std::pair<const char*, Result> results[] = {
+            {"LRU", replay<Lru>(refs, n_pages)},
+            {"CLOCK", replay<Clock>(refs, n_pages)},
+            {"ARC", replay<Arc>(refs, n_pages)},
+        };
+        for (const auto& [policy, res] : results) {
+            std::printf("%14s %6s %12llu %7.2f%%\n", argv[argi], policy, static_cast<unsigned long long>(res.misses),
+                refs.empty() ? 0.0 : 100.0 * static_cast<double>(res.misses) / static_cast<double>(refs.size()));
+            if (by_tag) {
+                for (const auto& [tag, misses] : res.misses_by_tag) {
+                    std::printf("%14s %6s %12llu %7.2f%%  tag %u\n", "", "", static_cast<unsigned long long>(misses),
+                        100.0 * static_cast<double>(misses) / static_cast<double>(refs_by_tag[tag]), tag);
+                }
+            }
+        }
+    }
+}